@@ -0,0 +1,173 @@
+/*
+	XboxImageXploder - Utility for modifying xbox executables.
+
+	XboxBatchProcessor.cpp - Types and functions for processing large numbers of xbox executable files in parallel.
+
+	Author - Grimdoomer
+*/
+
+#include "XboxBatchProcessor.h"
+#include "XboxExecutable.h"
+
+XboxBatchProcessor::XboxBatchProcessor(int maxInFlight) : vFileNames(), fOperation()
+{
+	SYSTEM_INFO sSystemInfo;
+
+	// Check if a limit was specified and if not base it off the number of processors in the system.
+	if (maxInFlight <= 0)
+	{
+		GetSystemInfo(&sSystemInfo);
+		maxInFlight = sSystemInfo.dwNumberOfProcessors * XBOX_BATCH_FILES_PER_PROCESSOR;
+	}
+
+	// Initialize fields.
+	this->maxInFlight = min(maxInFlight, XBOX_BATCH_MAX_IN_FLIGHT);
+	this->nextFileIndex = 0;
+	this->filesSucceeded = 0;
+	this->filesFailed = 0;
+}
+
+bool XboxBatchProcessor::LoadFileList(std::string listFileName)
+{
+	DWORD BytesRead = 0;
+
+	// Open the file list for reading.
+	HANDLE hListFile = CreateFileA(listFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hListFile == INVALID_HANDLE_VALUE)
+	{
+		// Failed to open the file list.
+		printf("Failed to open \"%s\": %d\n", listFileName.c_str(), GetLastError());
+		return false;
+	}
+
+	// Allocate a buffer for the file list contents.
+	DWORD fileSize = GetFileSize(hListFile, nullptr);
+	char *pbListData = (char*)malloc(fileSize + 1);
+	if (pbListData == nullptr)
+	{
+		// Failed to allocate memory for the file list.
+		printf("Failed to allocate memory for file list!\n");
+		CloseHandle(hListFile);
+		return false;
+	}
+
+	// Read the file list.
+	if (ReadFile(hListFile, pbListData, fileSize, &BytesRead, nullptr) == FALSE || BytesRead != fileSize)
+	{
+		// Failed to read the file list.
+		printf("Failed to read file list!\n");
+		free(pbListData);
+		CloseHandle(hListFile);
+		return false;
+	}
+
+	// Null terminate the buffer so we can walk it as a string.
+	pbListData[fileSize] = 0;
+	CloseHandle(hListFile);
+
+	// Loop and parse each line of the file list.
+	char *pLineStart = pbListData;
+	while (*pLineStart != 0)
+	{
+		// Find the end of the current line.
+		char *pLineEnd = pLineStart;
+		while (*pLineEnd != 0 && *pLineEnd != '\r' && *pLineEnd != '\n')
+			pLineEnd++;
+
+		// Skip blank lines and comments.
+		if (pLineEnd != pLineStart && *pLineStart != '#')
+			this->vFileNames.push_back(std::string(pLineStart, pLineEnd - pLineStart));
+
+		// Skip over the line terminators.
+		while (*pLineEnd == '\r' || *pLineEnd == '\n')
+			pLineEnd++;
+
+		// Next line.
+		pLineStart = pLineEnd;
+	}
+
+	// Free the file list buffer.
+	free(pbListData);
+	return true;
+}
+
+void XboxBatchProcessor::AddFile(std::string fileName)
+{
+	// Add the file to the list of files to process.
+	this->vFileNames.push_back(fileName);
+}
+
+int XboxBatchProcessor::Run(XboxBatchOperation operation)
+{
+	// Reset the batch state.
+	this->fOperation = operation;
+	this->nextFileIndex = 0;
+	this->filesSucceeded = 0;
+	this->filesFailed = 0;
+
+	// There's no point creating more workers than there are files.
+	int workerCount = min(this->maxInFlight, (int)this->vFileNames.size());
+
+	// Create the worker threads, each one pulls files off the list until there are none left.
+	std::vector<HANDLE> vWorkerThreads;
+	for (int i = 0; i < workerCount; i++)
+	{
+		// Create the worker thread.
+		HANDLE hThread = CreateThread(nullptr, 0, WorkerThreadProc, this, 0, nullptr);
+		if (hThread == NULL)
+		{
+			// Failed to create the worker, continue with the threads we have.
+			printf("Failed to create worker thread: %d\n", GetLastError());
+			break;
+		}
+
+		vWorkerThreads.push_back(hThread);
+	}
+
+	// If we failed to create any workers process the files on this thread.
+	if (vWorkerThreads.size() == 0)
+		ProcessFiles();
+
+	// Wait for all of the workers to finish.
+	for (size_t i = 0; i < vWorkerThreads.size(); i++)
+	{
+		WaitForSingleObject(vWorkerThreads[i], INFINITE);
+		CloseHandle(vWorkerThreads[i]);
+	}
+
+	return this->filesFailed;
+}
+
+DWORD WINAPI XboxBatchProcessor::WorkerThreadProc(LPVOID lpParameter)
+{
+	// Process files until the list is exhausted.
+	((XboxBatchProcessor*)lpParameter)->ProcessFiles();
+	return 0;
+}
+
+void XboxBatchProcessor::ProcessFiles()
+{
+	// Loop until there are no files left to process.
+	while (true)
+	{
+		// Claim the next file in the list.
+		LONG index = InterlockedIncrement(&this->nextFileIndex) - 1;
+		if (index >= (LONG)this->vFileNames.size())
+			break;
+
+		// Run the operation on the file and record the result. Output for the file is captured and printed all at once so it
+		// doesn't get mixed in with output from files being processed on other threads.
+		const std::string &fileName = this->vFileNames[index];
+		std::string output;
+		CaptureOutput(&output);
+		bool result = this->fOperation(fileName);
+		CaptureOutput(nullptr);
+
+		if (result == true)
+			InterlockedIncrement(&this->filesSucceeded);
+		else
+			InterlockedIncrement(&this->filesFailed);
+
+		printf("[%d/%d] %s: %s\n%s", index + 1, (int)this->vFileNames.size(), fileName.c_str(), result == true ? "OK" : "FAILED", output.c_str());
+	}
+}
@@ -0,0 +1,58 @@
+/*
+	XboxImageXploder - Utility for modifying xbox executables.
+
+	XboxBatchProcessor.h - Types and functions for processing large numbers of xbox executable files in parallel.
+
+	Author - Grimdoomer
+*/
+
+#pragma once
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+// ---------------------------------------------------------------------------------------
+// Types
+// ---------------------------------------------------------------------------------------
+
+// Number of files kept in flight per processor when no limit is specified. Each file spends most of its time
+// waiting on small synchronous reads and writes so we oversubscribe the processors to keep the disk queue full.
+#define XBOX_BATCH_FILES_PER_PROCESSOR		4
+
+// Upper bound on the number of worker threads, regardless of what the user asks for.
+#define XBOX_BATCH_MAX_IN_FLIGHT			256
+
+// Callback invoked for each file in the batch, returns true if the file was processed successfully.
+typedef std::function<bool(const std::string&)> XboxBatchOperation;
+
+// ---------------------------------------------------------------------------------------
+// XboxBatchProcessor
+// ---------------------------------------------------------------------------------------
+class XboxBatchProcessor
+{
+private:
+	std::vector<std::string>	vFileNames;
+	int							maxInFlight;
+
+	XboxBatchOperation			fOperation;
+
+	volatile LONG				nextFileIndex;
+	volatile LONG				filesSucceeded;
+	volatile LONG				filesFailed;
+
+	static DWORD WINAPI WorkerThreadProc(LPVOID lpParameter);
+	void ProcessFiles();
+
+public:
+	XboxBatchProcessor(int maxInFlight);
+
+	bool LoadFileList(std::string listFileName);
+	void AddFile(std::string fileName);
+
+	int Run(XboxBatchOperation operation);
+
+	int GetFileCount() { return (int)this->vFileNames.size(); }
+	int GetSucceededCount() { return this->filesSucceeded; }
+	int GetFailedCount() { return this->filesFailed; }
+};
@@ -8,6 +8,11 @@
 
 #include "XboxExecutable.h"
 #include <assert.h>
+#include <stdarg.h>
+#include <algorithm>
+
+// Output buffer for the current thread when its output is being captured, or nullptr if output goes straight to the console.
+static thread_local std::string *pCapturedOutput = nullptr;
 
 XboxExecutable::XboxExecutable(std::string fileName) : sFileName(), vSectionHeaderNames(), sDebugFullFileName(), sDebugFileNameUnicode()
 {
@@ -15,6 +20,11 @@ XboxExecutable::XboxExecutable(std::string fileName) : sFileName(), vSectionHead
 	this->sFileName = fileName;
 	this->hFileHandle = INVALID_HANDLE_VALUE;
 	this->bIsValid = false;
+	this->originalSizeOfImage = 0;
+	this->pSectionHeaders = nullptr;
+	this->pLibraryVersions = nullptr;
+	this->pLibraryFeatures = nullptr;
+	this->pbLogoBitmap = nullptr;
 }
 
 XboxExecutable::~XboxExecutable()
@@ -33,6 +43,11 @@ XboxExecutable::~XboxExecutable()
 		free(this->pLibraryVersions);
 	}
 
+	if (this->pLibraryFeatures)
+	{
+		free(this->pLibraryFeatures);
+	}
+
 	if (this->pbLogoBitmap)
 	{
 		free(this->pbLogoBitmap);
@@ -46,19 +61,46 @@ XboxExecutable::~XboxExecutable()
 	}
 }
 
-bool XboxExecutable::ReadExecutable()
+// Reads a null terminated string from the header buffer, making sure it doesn't run past the end of the buffer.
+template<typename T> static bool ReadHeaderString(const BYTE *pbBuffer, DWORD bufferSize, DWORD offset, std::basic_string<T> &str)
+{
+	// Make sure the start of the string is within the buffer.
+	if (offset >= bufferSize)
+		return false;
+
+	// Find the null terminator.
+	const T *pStart = (const T*)(pbBuffer + offset);
+	DWORD maxLength = (bufferSize - offset) / sizeof(T);
+	for (DWORD i = 0; i < maxLength; i++)
+	{
+		if (pStart[i] == 0)
+		{
+			str.assign(pStart, i);
+			return true;
+		}
+	}
+
+	// String is not terminated within the buffer.
+	return false;
+}
+
+bool XboxExecutable::ReadExecutable(bool readOnly)
 {
 	bool result = false;
 	DWORD BytesRead = 0;
 	BYTE abHeaderData[XBE_IMAGE_HEADER_MIN_SIZE];
 	BYTE* pbBuffer = nullptr;
 
-	// Open the image file for reading and writing.
-	this->hFileHandle = CreateFileA(this->sFileName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	// Open the image file for reading and writing, or just reading if we are only inspecting it. Other processes are allowed to read
+	// the file so an emulator or file transfer can pick up the image while the daemon keeps it open.
+	if (readOnly == true)
+		this->hFileHandle = CreateFileA(this->sFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	else
+		this->hFileHandle = CreateFileA(this->sFileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
 	if (this->hFileHandle == INVALID_HANDLE_VALUE)
 	{
 		// Failed to open the file.
-		printf("Failed to open \"%s\": %d\n", this->sFileName.c_str(), GetLastError());
+		XboxPrintf("Failed to open \"%s\": %d\n", this->sFileName.c_str(), GetLastError());
 		return false;
 	}
 
@@ -66,7 +108,7 @@ bool XboxExecutable::ReadExecutable()
 	if (GetFileSize(this->hFileHandle, nullptr) < XBE_IMAGE_HEADER_MIN_SIZE)
 	{
 		// The file is too small to be a valid xbox executable.
-		printf("File is too small to be valid!\n");
+		XboxPrintf("File is too small to be valid!\n");
 		return false;
 	}
 
@@ -74,16 +116,17 @@ bool XboxExecutable::ReadExecutable()
 	if (ReadFile(this->hFileHandle, abHeaderData, XBE_IMAGE_HEADER_MIN_SIZE, &BytesRead, nullptr) == FALSE || BytesRead != XBE_IMAGE_HEADER_MIN_SIZE)
 	{
 		// Failed to read the image header.
-		printf("Failed to read image header!\n");
+		XboxPrintf("Failed to read image header!\n");
 		goto Cleanup;
 	}
 
 	// Validate the size of the image header.
 	XBE_IMAGE_HEADER* pTempHeader = (XBE_IMAGE_HEADER*)abHeaderData;
-	if (pTempHeader->SizeOfImageHeader < XBE_IMAGE_HEADER_MIN_SIZE)
+	if (pTempHeader->SizeOfImageHeader < XBE_IMAGE_HEADER_MIN_SIZE || pTempHeader->SizeOfHeaders < XBE_IMAGE_HEADER_MIN_SIZE ||
+		pTempHeader->SizeOfImageHeader > pTempHeader->SizeOfHeaders || pTempHeader->SizeOfHeaders > GetFileSize(this->hFileHandle, nullptr))
 	{
 		// Image header size is invalid.
-		printf("Xbe image header size is invalid!\n");
+		XboxPrintf("Xbe image header size is invalid!\n");
 		goto Cleanup;
 	}
 
@@ -93,51 +136,72 @@ bool XboxExecutable::ReadExecutable()
 	if (pbBuffer == nullptr)
 	{
 		// Not enough memory for allocation.
-		printf("Failed to allocate memory for header data!\n");
+		XboxPrintf("Failed to allocate memory for header data!\n");
 		return false;
 	}
 
-	// Seek back to the start of the image.
-	SetFilePointer(this->hFileHandle, 0, nullptr, FILE_BEGIN);
-
-	// Read the image header.
-	if (ReadFile(this->hFileHandle, pbBuffer, headersSize, &BytesRead, nullptr) == FALSE || BytesRead != headersSize)
+	// Copy in the part of the header we already have and read the rest of the headers right after it, this saves
+	// us a seek and a second read of the same data.
+	memcpy(pbBuffer, abHeaderData, XBE_IMAGE_HEADER_MIN_SIZE);
+	if (ReadFile(this->hFileHandle, pbBuffer + XBE_IMAGE_HEADER_MIN_SIZE, headersSize - XBE_IMAGE_HEADER_MIN_SIZE, &BytesRead, nullptr) == FALSE ||
+		BytesRead != headersSize - XBE_IMAGE_HEADER_MIN_SIZE)
 	{
 		// Failed to read the image header.
-		printf("Failed to read image header!\n");
+		XboxPrintf("Failed to read image header!\n");
 		goto Cleanup;
 	}
 
+	// Copy the xbe header, any fields past the size of the image header are not used and are left cleared.
+	memset(&this->sHeader, 0, sizeof(XBE_IMAGE_HEADER));
+	memcpy(&this->sHeader, pbBuffer, min(pTempHeader->SizeOfImageHeader, (DWORD)sizeof(XBE_IMAGE_HEADER)));
+
 	// Check if the xbe header is valid.
-	this->sHeader = *(XBE_IMAGE_HEADER*)pbBuffer;
 	if (this->sHeader.Magic != XBE_IMAGE_HEADER_MAGIC)
 	{
 		// Xbe header is invalid.
-		printf("Xbe header has invalid magic!\n");
+		XboxPrintf("Xbe header has invalid magic!\n");
 		goto Cleanup;
 	}
 
-	// Clear additional fields if they are not used.
-	memset((PBYTE)&this->sHeader + this->sHeader.SizeOfImageHeader, 0, sizeof(XBE_IMAGE_HEADER) - this->sHeader.SizeOfImageHeader);
+	// Save the original image size so we can report how much it grows.
+	this->originalSizeOfImage = this->sHeader.SizeOfImage;
+
+	// Check the certificate is within the image headers.
+	if (XBE_HEADER_RANGE_VALID(&this->sHeader, this->sHeader.CertificateAddress, XBE_IMAGE_CERTIFICATE_MIN_SIZE) == false)
+	{
+		// Xbe certificate is outside of the image headers.
+		XboxPrintf("Xbe certificate is outside of the image headers!\n");
+		goto Cleanup;
+	}
 
 	// Check the size of the certificate is valid.
-	this->sCertificate = *(XBE_IMAGE_CERTIFICATE*)(pbBuffer + XBE_HEADER_OFFSET_OF(&this->sHeader, this->sHeader.CertificateAddress));
-	if (this->sCertificate.Size < XBE_IMAGE_CERTIFICATE_MIN_SIZE)
+	XBE_IMAGE_CERTIFICATE *pTempCertificate = (XBE_IMAGE_CERTIFICATE*)(pbBuffer + XBE_HEADER_OFFSET_OF(&this->sHeader, this->sHeader.CertificateAddress));
+	if (pTempCertificate->Size < XBE_IMAGE_CERTIFICATE_MIN_SIZE || XBE_HEADER_RANGE_VALID(&this->sHeader, this->sHeader.CertificateAddress, pTempCertificate->Size) == false)
 	{
 		// Xbe certificate has invalid size.
-		printf("Xbe certificate has invalid size!\n");
+		XboxPrintf("Xbe certificate has invalid size!\n");
 		goto Cleanup;
 	}
 
-	// Clear additional fields if they are not used.
-	memset((PBYTE)&this->sCertificate + this->sCertificate.Size, 0, sizeof(XBE_IMAGE_CERTIFICATE) - this->sCertificate.Size);
+	// Copy the certificate, any fields past the size of the certificate are not used and are left cleared.
+	memset(&this->sCertificate, 0, sizeof(XBE_IMAGE_CERTIFICATE));
+	memcpy(&this->sCertificate, pTempCertificate, min(pTempCertificate->Size, (DWORD)sizeof(XBE_IMAGE_CERTIFICATE)));
+
+	// Check the section headers are within the image headers.
+	if (this->sHeader.NumberOfSections == 0 || XBE_HEADER_RANGE_VALID(&this->sHeader, this->sHeader.SectionHeadersAddress,
+		(ULONGLONG)this->sHeader.NumberOfSections * sizeof(XBE_IMAGE_SECTION_HEADER)) == false)
+	{
+		// Section headers are outside of the image headers.
+		XboxPrintf("Xbe section headers are outside of the image headers!\n");
+		goto Cleanup;
+	}
 
 	// Allocate memory for the section headers.
 	this->pSectionHeaders = (XBE_IMAGE_SECTION_HEADER*)malloc(this->sHeader.NumberOfSections * sizeof(XBE_IMAGE_SECTION_HEADER));
 	if (this->pSectionHeaders == nullptr)
 	{
 		// Failed to allocate memory for section headers.
-		printf("Failed to allocate memory for section headers!\n");
+		XboxPrintf("Failed to allocate memory for section headers!\n");
 		goto Cleanup;
 	}
 
@@ -152,8 +216,16 @@ bool XboxExecutable::ReadExecutable()
 		if (this->pSectionHeaders[i].SectionNameAddress)
 		{
 			// Save the section header name.
-			char *pNamePtr = (char*)pbBuffer + XBE_HEADER_OFFSET_OF(&this->sHeader, this->pSectionHeaders[i].SectionNameAddress);
-			this->vSectionHeaderNames.push_back(std::string(pNamePtr));
+			std::string sectionName;
+			if (XBE_HEADER_RANGE_VALID(&this->sHeader, this->pSectionHeaders[i].SectionNameAddress, 1) == false ||
+				ReadHeaderString(pbBuffer, headersSize, XBE_HEADER_OFFSET_OF(&this->sHeader, this->pSectionHeaders[i].SectionNameAddress), sectionName) == false)
+			{
+				// Section name is outside of the image headers.
+				XboxPrintf("Section %d name is outside of the image headers!\n", i);
+				goto Cleanup;
+			}
+
+			this->vSectionHeaderNames.push_back(sectionName);
 		}
 		else
 		{
@@ -166,43 +238,84 @@ bool XboxExecutable::ReadExecutable()
 	if (this->sHeader.ImportTableAddress > 0)
 	{
 		// Loop and read all the import table entries.
-		XBE_IMAGE_IMPORT_DESCRIPTOR* pImportDescriptor = (XBE_IMAGE_IMPORT_DESCRIPTOR*)(pbBuffer + XBE_HEADER_OFFSET_OF(&this->sHeader, this->sHeader.ImportTableAddress));
-		while (pImportDescriptor->ImageThunkData != 0)
+		DWORD importDescriptorAddress = this->sHeader.ImportTableAddress;
+		while (true)
 		{
+			// Make sure the import entry is within the image headers.
+			if (XBE_HEADER_RANGE_VALID(&this->sHeader, importDescriptorAddress, sizeof(XBE_IMAGE_IMPORT_DESCRIPTOR)) == false)
+			{
+				// Import table is outside of the image headers.
+				XboxPrintf("Xbe import table is outside of the image headers!\n");
+				goto Cleanup;
+			}
+
+			// Check for the end of the import table.
+			XBE_IMAGE_IMPORT_DESCRIPTOR* pImportDescriptor = (XBE_IMAGE_IMPORT_DESCRIPTOR*)(pbBuffer + XBE_HEADER_OFFSET_OF(&this->sHeader, importDescriptorAddress));
+			if (pImportDescriptor->ImageThunkData == 0)
+				break;
+
 			// Save the import module name.
-			WCHAR* pNamePtr = (WCHAR*)(pbBuffer + XBE_HEADER_OFFSET_OF(&this->sHeader, pImportDescriptor->ModuleNameAddress));
-			this->mImportDirectory.emplace(pImportDescriptor->ImageThunkData, std::wstring(pNamePtr));
+			std::wstring moduleName;
+			if (XBE_HEADER_RANGE_VALID(&this->sHeader, pImportDescriptor->ModuleNameAddress, sizeof(WCHAR)) == false ||
+				ReadHeaderString(pbBuffer, headersSize, XBE_HEADER_OFFSET_OF(&this->sHeader, pImportDescriptor->ModuleNameAddress), moduleName) == false)
+			{
+				// Import module name is outside of the image headers.
+				XboxPrintf("Xbe import module name is outside of the image headers!\n");
+				goto Cleanup;
+			}
+
+			this->mImportDirectory.emplace(pImportDescriptor->ImageThunkData, moduleName);
 
 			// Next import entry.
-			pImportDescriptor++;
+			importDescriptorAddress += sizeof(XBE_IMAGE_IMPORT_DESCRIPTOR);
 		}
 	}
 
-	// Allocate memory for the library versions.
-	this->pLibraryVersions = (XBOX_LIBRARY_VERSION*)malloc(this->sHeader.NumberOfLibraryVersions * sizeof(XBOX_LIBRARY_VERSION));
-	if (this->pLibraryVersions == nullptr)
+	// Check if there are library versions and if so read them.
+	if (this->sHeader.NumberOfLibraryVersions > 0)
 	{
-		// Failed to allocate memory for library versions array.
-		printf("Failed to allocate memory for library versions!\n");
-		goto Cleanup;
-	}
+		// Check the library versions are within the image headers.
+		if (XBE_HEADER_RANGE_VALID(&this->sHeader, this->sHeader.LibraryVersionsAddress, (ULONGLONG)this->sHeader.NumberOfLibraryVersions * sizeof(XBOX_LIBRARY_VERSION)) == false)
+		{
+			// Library versions are outside of the image headers.
+			XboxPrintf("Xbe library versions are outside of the image headers!\n");
+			goto Cleanup;
+		}
 
-	// Loop and read all of the library versions.
-	for (int i = 0; i < this->sHeader.NumberOfLibraryVersions; i++)
-	{
-		this->pLibraryVersions[i] = *(XBOX_LIBRARY_VERSION*)(pbBuffer +
-			XBE_HEADER_OFFSET_OF(&this->sHeader, this->sHeader.LibraryVersionsAddress) + (i * sizeof(XBOX_LIBRARY_VERSION)));
+		// Allocate memory for the library versions.
+		this->pLibraryVersions = (XBOX_LIBRARY_VERSION*)malloc(this->sHeader.NumberOfLibraryVersions * sizeof(XBOX_LIBRARY_VERSION));
+		if (this->pLibraryVersions == nullptr)
+		{
+			// Failed to allocate memory for library versions array.
+			XboxPrintf("Failed to allocate memory for library versions!\n");
+			goto Cleanup;
+		}
+
+		// Loop and read all of the library versions.
+		for (int i = 0; i < this->sHeader.NumberOfLibraryVersions; i++)
+		{
+			this->pLibraryVersions[i] = *(XBOX_LIBRARY_VERSION*)(pbBuffer +
+				XBE_HEADER_OFFSET_OF(&this->sHeader, this->sHeader.LibraryVersionsAddress) + (i * sizeof(XBOX_LIBRARY_VERSION)));
+		}
 	}
 
 	// Check if there are library features and if so read them.
 	if (this->sHeader.NumberOfLibraryFeatures > 0)
 	{
+		// Check the library features are within the image headers.
+		if (XBE_HEADER_RANGE_VALID(&this->sHeader, this->sHeader.LibraryFeaturesAddress, (ULONGLONG)this->sHeader.NumberOfLibraryFeatures * sizeof(XBOX_LIBRARY_VERSION)) == false)
+		{
+			// Library features are outside of the image headers.
+			XboxPrintf("Xbe library features are outside of the image headers!\n");
+			goto Cleanup;
+		}
+
 		// Allocate memory for the library features.
 		this->pLibraryFeatures = (XBOX_LIBRARY_VERSION*)malloc(this->sHeader.NumberOfLibraryFeatures * sizeof(XBOX_LIBRARY_VERSION));
 		if (this->pLibraryFeatures == nullptr)
 		{
 			// Failed to allocate memory for library features array.
-			printf("Failed to allocate memory for library features!\n");
+			XboxPrintf("Failed to allocate memory for library features!\n");
 			goto Cleanup;
 		}
 
@@ -229,24 +342,51 @@ bool XboxExecutable::ReadExecutable()
 		this->sHeader.XAPILibraryVersionAddress -= this->sHeader.LibraryVersionsAddress;
 
 	// Read the debug file names.
-	if (this->sHeader.FullFileNameAddress)	
-		this->sDebugFullFileName = (CHAR*)(pbBuffer + XBE_HEADER_OFFSET_OF(&this->sHeader, this->sHeader.FullFileNameAddress));
+	if ((this->sHeader.FullFileNameAddress && (XBE_HEADER_RANGE_VALID(&this->sHeader, this->sHeader.FullFileNameAddress, 1) == false ||
+		ReadHeaderString(pbBuffer, headersSize, XBE_HEADER_OFFSET_OF(&this->sHeader, this->sHeader.FullFileNameAddress), this->sDebugFullFileName) == false)) ||
+		(this->sHeader.UnicodeFileNameAddress && (XBE_HEADER_RANGE_VALID(&this->sHeader, this->sHeader.UnicodeFileNameAddress, sizeof(WCHAR)) == false ||
+		ReadHeaderString(pbBuffer, headersSize, XBE_HEADER_OFFSET_OF(&this->sHeader, this->sHeader.UnicodeFileNameAddress), this->sDebugFileNameUnicode) == false)))
+	{
+		// Debug file names are outside of the image headers.
+		XboxPrintf("Xbe debug file names are outside of the image headers!\n");
+		goto Cleanup;
+	}
+
 	if (this->sHeader.FileNameAddress)
 		this->sHeader.FileNameAddress -= this->sHeader.FullFileNameAddress;
-	if (this->sHeader.UnicodeFileNameAddress)
-		this->sDebugFileNameUnicode = (WCHAR*)(pbBuffer + XBE_HEADER_OFFSET_OF(&this->sHeader, this->sHeader.UnicodeFileNameAddress));
+
+	// Check the logo bitmap is within the file. Some xbe files don't include the logo bitmap in SizeOfHeaders so it may be past the
+	// end of the header data we read.
+	if (this->sHeader.LogoBitmapAddress < this->sHeader.BaseAddress ||
+		(ULONGLONG)(this->sHeader.LogoBitmapAddress - this->sHeader.BaseAddress) + this->sHeader.LogoBitmapSize > GetFileSize(this->hFileHandle, nullptr))
+	{
+		// Logo bitmap is outside of the file.
+		XboxPrintf("Xbe logo bitmap is outside of the file!\n");
+		goto Cleanup;
+	}
 
 	// Allocate memory for the logo bitmap.
 	this->pbLogoBitmap = (BYTE*)malloc(this->sHeader.LogoBitmapSize);
 	if (this->pbLogoBitmap == nullptr)
 	{
 		// Failed to allocate memory for the logo bitmap.
-		printf("Failed to allocate memory for the logo bitmap!\n");
+		XboxPrintf("Failed to allocate memory for the logo bitmap!\n");
 		goto Cleanup;
 	}
 
-	// Copy the logo bitmap data.
-	memcpy(this->pbLogoBitmap, pbBuffer + XBE_HEADER_OFFSET_OF(&this->sHeader, this->sHeader.LogoBitmapAddress), this->sHeader.LogoBitmapSize);
+	// Copy the logo bitmap data, or read it from the file if it's not within the header data.
+	if (XBE_HEADER_RANGE_VALID(&this->sHeader, this->sHeader.LogoBitmapAddress, this->sHeader.LogoBitmapSize) == true)
+		memcpy(this->pbLogoBitmap, pbBuffer + XBE_HEADER_OFFSET_OF(&this->sHeader, this->sHeader.LogoBitmapAddress), this->sHeader.LogoBitmapSize);
+	else
+	{
+		SetFilePointer(this->hFileHandle, XBE_HEADER_OFFSET_OF(&this->sHeader, this->sHeader.LogoBitmapAddress), nullptr, FILE_BEGIN);
+		if (ReadFile(this->hFileHandle, this->pbLogoBitmap, this->sHeader.LogoBitmapSize, &BytesRead, nullptr) == FALSE || BytesRead != this->sHeader.LogoBitmapSize)
+		{
+			// Failed to read the logo bitmap.
+			XboxPrintf("Failed to read the logo bitmap!\n");
+			goto Cleanup;
+		}
+	}
 
 	// Successfully read the image header.
 	result = this->bIsValid = true;
@@ -258,7 +398,7 @@ Cleanup:
 	return result;
 }
 
-bool XboxExecutable::AddSectionForHacks(std::string sectionName, int sectionSize)
+bool XboxExecutable::AddSectionForHacks(std::string sectionName, DWORD sectionSize, DWORD sectionFlags, bool packedLayout)
 {
 	DWORD BytesWritten = 0;
 
@@ -266,56 +406,51 @@ bool XboxExecutable::AddSectionForHacks(std::string sectionName, int sectionSize
 	if (this->bIsValid == false)
 		return false;
 
-	// Allocate a new array for the section headers.
-	XBE_IMAGE_SECTION_HEADER *pNewSectionHeaders = (XBE_IMAGE_SECTION_HEADER*)malloc(sizeof(XBE_IMAGE_SECTION_HEADER) * (this->sHeader.NumberOfSections + 1));
-	if (pNewSectionHeaders == nullptr)
+	// Check the section size is valid.
+	if (sectionSize == 0 || sectionSize > XBE_SECTION_MAX_SIZE)
 	{
-		// Failed to allocate memory for new section header array.
-		printf("Failed to allocate memory for new section headers!\n");
+		// Section size is invalid.
+		XboxPrintf("Section size 0x%08x is invalid, must be between 1 and 0x%08x bytes!\n", sectionSize, XBE_SECTION_MAX_SIZE);
 		return false;
 	}
 
-	// Copy the old section headers into the new array.
-	memcpy(pNewSectionHeaders, this->pSectionHeaders, this->sHeader.NumberOfSections * sizeof(XBE_IMAGE_SECTION_HEADER));
-	
-	// Free the old array and assign the new pointer.
-	free(this->pSectionHeaders);
-	this->pSectionHeaders = pNewSectionHeaders;
-	this->sHeader.NumberOfSections += 1;
-
-	// Pointers for easy access.
-	XBE_IMAGE_SECTION_HEADER *pNewSection = &this->pSectionHeaders[this->sHeader.NumberOfSections - 1];
-	XBE_IMAGE_SECTION_HEADER *pLastSection = &this->pSectionHeaders[this->sHeader.NumberOfSections - 2];
-
-	// Initialize the new section header.
-	memset(pNewSection, 0, sizeof(XBE_IMAGE_SECTION_HEADER));
-	pNewSection->SectionFlags = (XBE_SECTION_FLAGS_WRITABLE | XBE_SECTION_FLAGS_PRELOAD | XBE_SECTION_FLAGS_EXECUTABLE);
-	pNewSection->VirtualAddress = ALIGN_TO(pLastSection->VirtualAddress + pLastSection->VirtualSize, 4096);
-	pNewSection->VirtualSize = ALIGN_TO(sectionSize, 4);
-	pNewSection->RawAddress = ALIGN_TO(pLastSection->RawAddress + pLastSection->RawSize, 4096);
-	pNewSection->RawSize = ALIGN_TO(sectionSize, 4);
-	pNewSection->SectionNameReferenceCount = 0;
+	// Check there isn't already a section with the same name, otherwise writes by section name would go to the first one.
+	if (FindSection(sectionName) != -1)
+	{
+		// Section name is already used.
+		XboxPrintf("Section \"%s\" already exists!\n", sectionName.c_str());
+		return false;
+	}
 
-	// Save the section header name.
-	this->vSectionHeaderNames.push_back(sectionName);
+	// Get the end of the section data or the file, whichever is further, before we add the new section. Anything past the last section's
+	// data must be preserved so the new section data is always placed after it.
+	DWORD imageDataEnd = max(FindImageDataEndOffset(), GetFileSize(this->hFileHandle, nullptr));
 
 	// Some xbe files will contain the original PE headers and include that data and the logo bitmap into SizeOfHeaders. Others
 	// don't and SizeOfHeaders does not include the size of the logo bitmap. To make things easier we set SizeOfHeaders to the absolute
 	// maximum header size possible based on the virtual address of the first image section.
-	this->sHeader.SizeOfHeaders = this->pSectionHeaders[0].VirtualAddress - this->sHeader.BaseAddress;
+	if (this->pSectionHeaders[0].VirtualAddress < this->sHeader.BaseAddress + this->sHeader.SizeOfHeaders)
+	{
+		// First section overlaps the image headers.
+		XboxPrintf("First section overlaps the image headers! Adding a new section not possible!\n");
+		return false;
+	}
+
+	DWORD newSizeOfHeaders = this->pSectionHeaders[0].VirtualAddress - this->sHeader.BaseAddress;
 
-	// Check if the xbe has a valid PE header.
+	// Check if the xbe has a valid PE header, it must be within the image headers for us to copy it.
 	bool hasPeHeaders = false;
-	if (this->sHeader.PEBaseAddress > 0)
+	DWORD peHeaderOffset = this->sHeader.PEBaseAddress - this->sHeader.BaseAddress;
+	if (this->sHeader.PEBaseAddress >= this->sHeader.BaseAddress && (ULONGLONG)peHeaderOffset + 2 <= newSizeOfHeaders)
 	{
 		WORD wMagic = 0;
 
 		// Seek to where the PE headers should start and check the magic value.
-		SetFilePointer(this->hFileHandle, this->sHeader.PEBaseAddress - this->sHeader.BaseAddress, NULL, FILE_BEGIN);
+		SetFilePointer(this->hFileHandle, peHeaderOffset, NULL, FILE_BEGIN);
 		if (ReadFile(this->hFileHandle, &wMagic, 2, &BytesWritten, NULL) == FALSE || BytesWritten != 2)
 		{
 			// Failed to read PE header magic.
-			printf("Failed to read PE header data!\n");
+			XboxPrintf("Failed to read PE header data!\n");
 			return false;
 		}
 
@@ -323,42 +458,111 @@ bool XboxExecutable::AddSectionForHacks(std::string sectionName, int sectionSize
 		hasPeHeaders = wMagic == 'ZM';
 	}
 
-	// Calculate how much space we have to work with based on whether or not the image has a valid PE header.
+	// The logo bitmap may be outside of the original headers, make sure it still ends before the first section or there's nowhere to
+	// put the rebuilt headers.
+	ULONGLONG logoBitmapEndOffset = (ULONGLONG)(this->sHeader.LogoBitmapAddress - this->sHeader.BaseAddress) + this->sHeader.LogoBitmapSize;
+	if (logoBitmapEndOffset > newSizeOfHeaders)
+	{
+		// Logo bitmap overlaps the section data.
+		XboxPrintf("Xbe logo bitmap ends past the start of the first section! Adding a new section not possible!\n");
+		return false;
+	}
+
+	// Calculate how much space we have to work with based on whether or not the image has a valid PE header. If the PE headers start
+	// before the end of the logo bitmap there's no space in front of them.
 	DWORD headerSizeRemaining = 0;
-	DWORD logoBitmapEndOffset = (this->sHeader.LogoBitmapAddress - this->sHeader.BaseAddress) + this->sHeader.LogoBitmapSize;
 	if (hasPeHeaders == true)
-		headerSizeRemaining = (this->sHeader.PEBaseAddress - this->sHeader.BaseAddress) - logoBitmapEndOffset;
+		headerSizeRemaining = peHeaderOffset > logoBitmapEndOffset ? peHeaderOffset - (DWORD)logoBitmapEndOffset : 0;
 	else
-		headerSizeRemaining = this->sHeader.SizeOfHeaders - logoBitmapEndOffset;
+		headerSizeRemaining = newSizeOfHeaders - (DWORD)logoBitmapEndOffset;
+
+	// Calculate where the new section will go. It starts on the page after the last section so it never shares a head page, and only
+	// needs a separate tail page counter if it spans more than one page.
+	XBE_IMAGE_SECTION_HEADER *pLastSection = &this->pSectionHeaders[this->sHeader.NumberOfSections - 1];
+	DWORD newVirtualAddress = ALIGN_TO(pLastSection->VirtualAddress + pLastSection->VirtualSize, 4096);
+	DWORD newSectionSize = ALIGN_TO(sectionSize, 4);
+	bool newSectionSinglePage = ((newVirtualAddress + newSectionSize - 1) & ~(XBOX_PAGE_SIZE - 1)) == newVirtualAddress;
+
+	// Figure out how many shared page counters are needed once the new section is added.
+	std::vector<int> vHeadCounterIndex, vTailCounterIndex;
+	int sharedPageCounterCount = CalculateSharedPageCounters(vHeadCounterIndex, vTailCounterIndex) + (newSectionSinglePage == true ? 1 : 2);
 
 	// Calculate the expected size increase and check if there's enough room in the header. We add an additional 16 bytes here to account
 	// for padding on data that has moved around and may increase/decrease in size (it's not very scientific and should be calculated in a
-	// more accurate way).
-	DWORD headerSizeRequired = ALIGN_TO(sizeof(XBE_IMAGE_SECTION_HEADER) + sectionName.length() + 16, 4);
+	// more accurate way). Any shared page counters beyond one per section boundary are accounted for as well.
+	DWORD headerSizeRequired = ALIGN_TO(sizeof(XBE_IMAGE_SECTION_HEADER) + sectionName.length() + 16 +
+		max(sharedPageCounterCount - (int)this->sHeader.NumberOfSections - 2, 0) * sizeof(WORD), 4);
+	bool discardPeHeaders = false;
 	if (headerSizeRequired > headerSizeRemaining)
 	{
 		// Check if the image still has the PE headers and determine if discarding them will help.
-		if (hasPeHeaders == true && this->sHeader.SizeOfHeaders - logoBitmapEndOffset >= headerSizeRequired)
+		if (hasPeHeaders == true && newSizeOfHeaders - logoBitmapEndOffset >= headerSizeRequired)
 		{
 			// Discard the PE headers to make room for the new section headers.
-			printf("Not enough space in XBE header to add new section data, PE headers will be discarded...\n");
-			this->sHeader.PEBaseAddress = 0;
-			hasPeHeaders = false;
+			XboxPrintf("Not enough space in XBE header to add new section data, PE headers will be discarded...\n");
+			discardPeHeaders = true;
 		}
 		else
 		{
 			// Not enough space remaining in the header to add a new section.
-			printf("Not enough space in XBE header to add new section data! Adding a new section not possible!\n");
+			XboxPrintf("Not enough space in XBE header to add new section data! Adding a new section not possible!\n");
 			return false;
 		}
 	}
 
+	// Allocate a new array for the section headers.
+	XBE_IMAGE_SECTION_HEADER *pNewSectionHeaders = (XBE_IMAGE_SECTION_HEADER*)malloc(sizeof(XBE_IMAGE_SECTION_HEADER) * (this->sHeader.NumberOfSections + 1));
+	if (pNewSectionHeaders == nullptr)
+	{
+		// Failed to allocate memory for new section header array.
+		XboxPrintf("Failed to allocate memory for new section headers!\n");
+		return false;
+	}
+
+	// All the checks have passed, from here on we start modifying the image.
+	if (discardPeHeaders == true)
+	{
+		this->sHeader.PEBaseAddress = 0;
+		hasPeHeaders = false;
+	}
+
+	this->sHeader.SizeOfHeaders = newSizeOfHeaders;
+
+	// Copy the old section headers into the new array.
+	memcpy(pNewSectionHeaders, this->pSectionHeaders, this->sHeader.NumberOfSections * sizeof(XBE_IMAGE_SECTION_HEADER));
+	
+	// Free the old array and assign the new pointer.
+	free(this->pSectionHeaders);
+	this->pSectionHeaders = pNewSectionHeaders;
+	this->sHeader.NumberOfSections += 1;
+
+	// Initialize the new section header.
+	XBE_IMAGE_SECTION_HEADER *pNewSection = &this->pSectionHeaders[this->sHeader.NumberOfSections - 1];
+	memset(pNewSection, 0, sizeof(XBE_IMAGE_SECTION_HEADER));
+	pNewSection->SectionFlags = sectionFlags;
+	pNewSection->VirtualAddress = newVirtualAddress;
+	pNewSection->VirtualSize = newSectionSize;
+	pNewSection->RawSize = newSectionSize;
+	pNewSection->SectionNameReferenceCount = 0;
+
+	// The packed layout places the raw data right after the end of the image data instead of on the next page.
+	if (packedLayout == true)
+		pNewSection->RawAddress = ALIGN_TO(imageDataEnd, XBE_SECTION_RAW_PACKED_ALIGNMENT);
+	else
+		pNewSection->RawAddress = ALIGN_TO(imageDataEnd, 4096);
+
+	// Save the section header name.
+	this->vSectionHeaderNames.push_back(sectionName);
+
+	// Assign the shared page counters now the new section has been added.
+	CalculateSharedPageCounters(vHeadCounterIndex, vTailCounterIndex);
+
 	// Allocate a new buffer for the header data.
 	BYTE *pbNewHeader = (PBYTE)malloc(this->sHeader.SizeOfHeaders);
 	if (pbNewHeader == nullptr)
 	{
 		// Failed to allocate memory for new header buffer.
-		printf("Failed to allocate memory for new header buffer!\n");
+		XboxPrintf("Failed to allocate memory for new header buffer!\n");
 		return false;
 	}
 
@@ -389,12 +593,12 @@ bool XboxExecutable::AddSectionForHacks(std::string sectionName, int sectionSize
 
 	// Loop through all of the section headers and correct the section name addresses.
 	WORD *pSharedPagePtr = (WORD*)ALIGN_TO(pSectionHeaders + pXbeHeader->NumberOfSections, 4);
-	char *pNamePtr = (char*)ALIGN_TO(pSharedPagePtr + pXbeHeader->NumberOfSections + 1, 4);
+	char *pNamePtr = (char*)ALIGN_TO(pSharedPagePtr + sharedPageCounterCount, 4);
 	for (int i = 0; i < pXbeHeader->NumberOfSections; i++)
 	{
 		// Update the section header shared head/tail page address.
-		pSectionHeaders[i].HeadSharedPageReferenceCount = XBE_HEADER_ADDRESS_OF(pXbeHeader, pSharedPagePtr + i);
-		pSectionHeaders[i].TailSharedPageReferenceCount = XBE_HEADER_ADDRESS_OF(pXbeHeader, pSharedPagePtr + i + 1);
+		pSectionHeaders[i].HeadSharedPageReferenceCount = XBE_HEADER_ADDRESS_OF(pXbeHeader, pSharedPagePtr + vHeadCounterIndex[i]);
+		pSectionHeaders[i].TailSharedPageReferenceCount = XBE_HEADER_ADDRESS_OF(pXbeHeader, pSharedPagePtr + vTailCounterIndex[i]);
 
 		// Update the section name address.
 		pSectionHeaders[i].SectionNameAddress = XBE_HEADER_ADDRESS_OF(pXbeHeader, pNamePtr);
@@ -435,7 +639,8 @@ bool XboxExecutable::AddSectionForHacks(std::string sectionName, int sectionSize
 
 	// Copy library versions to the new buffer.
 	XBOX_LIBRARY_VERSION *pLibraryVersions = (XBOX_LIBRARY_VERSION*)ALIGN_TO(pNamePtr, 4);
-	memcpy(pLibraryVersions, this->pLibraryVersions, sizeof(XBOX_LIBRARY_VERSION) * pXbeHeader->NumberOfLibraryVersions);
+	if (pXbeHeader->NumberOfLibraryVersions > 0)
+		memcpy(pLibraryVersions, this->pLibraryVersions, sizeof(XBOX_LIBRARY_VERSION) * pXbeHeader->NumberOfLibraryVersions);
 
 	// Update the library version addresses.
 	pXbeHeader->LibraryVersionsAddress = XBE_HEADER_ADDRESS_OF(pXbeHeader, pLibraryVersions);
@@ -481,15 +686,14 @@ bool XboxExecutable::AddSectionForHacks(std::string sectionName, int sectionSize
 	// Update the logo bitmap data address.
 	pXbeHeader->LogoBitmapAddress = XBE_HEADER_ADDRESS_OF(pXbeHeader, pbBitmapData);
 
-	// Update the image size.
-	pXbeHeader->SizeOfImage += ALIGN_TO(pNewSection->VirtualSize, 4);
+	// Update the image size so it covers the new section, including the padding between the previous section and the new section's page.
+	pXbeHeader->SizeOfImage = max(pXbeHeader->SizeOfImage, (DWORD)ALIGN_TO(pNewSection->VirtualAddress + pNewSection->VirtualSize - pXbeHeader->BaseAddress, 4));
 
 	// Check if we need to copy in the original PE headers.
 	DWORD imageDataStart = FindImageDataStartOffset();
 	if (hasPeHeaders == true)
 	{
 		// Seek to the start of the PE headers.
-		DWORD peHeaderOffset = this->sHeader.PEBaseAddress - this->sHeader.BaseAddress;
 		SetFilePointer(this->hFileHandle, peHeaderOffset, NULL, FILE_BEGIN);
 
 		DWORD peHeadersSize = pXbeHeader->SizeOfHeaders - peHeaderOffset;
@@ -499,7 +703,8 @@ bool XboxExecutable::AddSectionForHacks(std::string sectionName, int sectionSize
 		if (ReadFile(this->hFileHandle, pNewPeHeaders, peHeadersSize, &BytesWritten, NULL) == FALSE || BytesWritten != peHeadersSize)
 		{
 			// Failed to read in pe headers.
-			printf("Failed to read original PE headers %d\n", GetLastError());
+			XboxPrintf("Failed to read original PE headers %d\n", GetLastError());
+			free(pbNewHeader);
 			return false;
 		}
 
@@ -512,40 +717,61 @@ bool XboxExecutable::AddSectionForHacks(std::string sectionName, int sectionSize
 	if (WriteFile(this->hFileHandle, pbNewHeader, pXbeHeader->SizeOfHeaders, &BytesWritten, nullptr) == FALSE || BytesWritten != pXbeHeader->SizeOfHeaders)
 	{
 		// Failed to write new image headers.
-		printf("Failed to write new image headers to file!\n");
+		XboxPrintf("Failed to write new image headers to file!\n");
+		free(pbNewHeader);
 		return false;
 	}
 
-	// Allocate an empty buffer to write to the file for the new section.
-	DWORD NewSectionSize = ALIGN_TO(sectionSize, 0x1000);
+	// Allocate an empty buffer to write to the file for the new section, the packed layout only writes as much data as the section needs.
+	DWORD NewSectionSize = packedLayout == true ? pNewSection->RawSize : ALIGN_TO(sectionSize, 0x1000);
 	BYTE *pbBlankData = (PBYTE)malloc(NewSectionSize);
 	if (pbBlankData == nullptr)
 	{
 		// Failed to allocate blank data for new section.
-		printf("Failed to allocate blank data for new section!\n");
+		XboxPrintf("Failed to allocate blank data for new section!\n");
+		free(pbNewHeader);
 		return false;
 	}
 
 	// Initialize the data to all 00s.
 	memset(pbBlankData, 0, NewSectionSize);
 
-	// Seek to the end of the file and write the blank data.
-	SetFilePointer(this->hFileHandle, 0, nullptr, FILE_END);
+	// Seek to where the section data starts and write the blank data.
+	SetFilePointer(this->hFileHandle, pNewSection->RawAddress, nullptr, FILE_BEGIN);
 
 	// Write the new section data.
 	if (WriteFile(this->hFileHandle, pbBlankData, NewSectionSize, &BytesWritten, nullptr) == FALSE || BytesWritten != NewSectionSize)
 	{
 		// Failed to write new section data to the file.
-		printf("Failed to write new section data to file!\n");
+		XboxPrintf("Failed to write new section data to file!\n");
+		free(pbBlankData);
+		free(pbNewHeader);
 		return false;
 	}
 
+	// Keep our copy of the header in sync with what was written to the file so more sections can be added without
+	// re-reading the image.
+	this->sHeader.SizeOfImage = pXbeHeader->SizeOfImage;
+	this->sHeader.PEBaseAddress = pXbeHeader->PEBaseAddress;
+	this->sHeader.LogoBitmapAddress = pXbeHeader->LogoBitmapAddress;
+	this->sHeader.SectionHeadersAddress = pXbeHeader->SectionHeadersAddress;
+	memcpy(this->pSectionHeaders, pSectionHeaders, sizeof(XBE_IMAGE_SECTION_HEADER) * pXbeHeader->NumberOfSections);
+
 	// Print the new section info.
-	printf("\nSection Name: \t\t%s\n", sectionName.c_str());
-	printf("Virtual Address: \t0x%08x\n", pNewSection->VirtualAddress);
-	printf("Virtual Size: \t\t0x%08x\n", pNewSection->VirtualSize);
-	printf("File Offset: \t\t0x%08x\n", pNewSection->RawAddress);
-	printf("File Size: \t\t0x%08x\n\n", pNewSection->RawSize);
+	XboxPrintf("\nSection Name: \t\t%s\n", sectionName.c_str());
+	XboxPrintf("Virtual Address: \t0x%08x\n", pNewSection->VirtualAddress);
+	XboxPrintf("Virtual Size: \t\t0x%08x\n", pNewSection->VirtualSize);
+	XboxPrintf("File Offset: \t\t0x%08x\n", pNewSection->RawAddress);
+	XboxPrintf("File Size: \t\t0x%08x\n", pNewSection->RawSize);
+	XboxPrintf("Section Flags: \t\t0x%08x%s\n\n", pNewSection->SectionFlags, (pNewSection->SectionFlags & XBE_SECTION_FLAGS_PRELOAD) == 0 ? " (not preloaded)" : "");
+
+	// Print how much file space the packed layout saved compared to the page aligned layout.
+	if (packedLayout == true)
+	{
+		DWORD alignedFileSize = ALIGN_TO(imageDataEnd, 4096) + ALIGN_TO(sectionSize, 0x1000);
+		DWORD packedFileSize = GetFileSize(this->hFileHandle, nullptr);
+		XboxPrintf("Packed File Size: \t0x%08x (saved 0x%08x bytes)\n\n", packedFileSize, alignedFileSize - packedFileSize);
+	}
 
 	// Free temp buffers.
 	free(pbBlankData);
@@ -555,6 +781,535 @@ bool XboxExecutable::AddSectionForHacks(std::string sectionName, int sectionSize
 	return true;
 }
 
+bool XboxExecutable::ExtendSection(std::string sectionName, DWORD additionalSize)
+{
+	DWORD BytesRead = 0;
+	DWORD BytesWritten = 0;
+
+	// Check to make sure the executable was loaded and is valid.
+	if (this->bIsValid == false)
+		return false;
+
+	// Find the section to extend.
+	int sectionIndex = FindSection(sectionName);
+	if (sectionIndex == -1)
+	{
+		// Section not found.
+		XboxPrintf("Section \"%s\" not found!\n", sectionName.c_str());
+		return false;
+	}
+
+	// Only the last section can be extended, anything else would require moving the sections after it.
+	XBE_IMAGE_SECTION_HEADER *pSection = &this->pSectionHeaders[sectionIndex];
+	bool isLastSection = sectionIndex == this->sHeader.NumberOfSections - 1 &&
+		pSection->RawAddress + pSection->RawSize == FindImageDataEndOffset();
+	for (int i = 0; i < this->sHeader.NumberOfSections && isLastSection == true; i++)
+	{
+		if (this->pSectionHeaders[i].VirtualAddress > pSection->VirtualAddress)
+			isLastSection = false;
+	}
+
+	if (isLastSection == false)
+	{
+		// Section is not the last section in the image.
+		XboxPrintf("Section \"%s\" is not the last section in the image, only the last section can be extended!\n", sectionName.c_str());
+		return false;
+	}
+
+	// Calculate the new section sizes and check they are valid.
+	ULONGLONG newVirtualSize = ((ULONGLONG)pSection->VirtualSize + additionalSize + 3) & ~3ULL;
+	ULONGLONG newRawSize = ((ULONGLONG)pSection->RawSize + additionalSize + 3) & ~3ULL;
+	if (additionalSize == 0 || newVirtualSize > XBE_SECTION_MAX_SIZE || newRawSize > XBE_SECTION_MAX_SIZE)
+	{
+		// Section size is invalid.
+		XboxPrintf("Section size 0x%08llx is invalid, must be between 1 and 0x%08x bytes!\n", newVirtualSize, XBE_SECTION_MAX_SIZE);
+		return false;
+	}
+
+	// A section that fits in a single page may use the same shared page counter for its head and tail page. If it grows onto another
+	// page it needs a separate tail counter, which requires rebuilding the image headers.
+	DWORD headPage = pSection->VirtualAddress & ~(XBOX_PAGE_SIZE - 1);
+	DWORD newTailPage = (pSection->VirtualAddress + (DWORD)newVirtualSize - 1) & ~(XBOX_PAGE_SIZE - 1);
+	if (newTailPage != headPage && pSection->HeadSharedPageReferenceCount == pSection->TailSharedPageReferenceCount)
+	{
+		// Section needs a new shared page counter.
+		XboxPrintf("Section \"%s\" can't grow past its first page because it uses one page counter for its head and tail, add a new section instead!\n",
+			sectionName.c_str());
+		return false;
+	}
+
+	// Allocate a buffer for the data being added to the section.
+	DWORD growSize = (DWORD)newRawSize - pSection->RawSize;
+	BYTE *pbGrowData = (BYTE*)malloc(growSize);
+	if (pbGrowData == nullptr)
+	{
+		// Failed to allocate memory for the new section data.
+		XboxPrintf("Failed to allocate memory for new section data!\n");
+		return false;
+	}
+
+	// Anything already in the file after the section will be overwritten. This is normally the page alignment padding written when
+	// the section was added, so only allow it if it's all zeros.
+	DWORD growOffset = pSection->RawAddress + pSection->RawSize;
+	DWORD fileSize = GetFileSize(this->hFileHandle, nullptr);
+	DWORD existingSize = fileSize > growOffset ? min(fileSize - growOffset, growSize) : 0;
+	SetFilePointer(this->hFileHandle, growOffset, nullptr, FILE_BEGIN);
+	if (existingSize > 0 && (ReadFile(this->hFileHandle, pbGrowData, existingSize, &BytesRead, nullptr) == FALSE || BytesRead != existingSize))
+	{
+		// Failed to read the data after the section.
+		XboxPrintf("Failed to read data after section \"%s\"!\n", sectionName.c_str());
+		free(pbGrowData);
+		return false;
+	}
+
+	for (DWORD i = 0; i < existingSize; i++)
+	{
+		if (pbGrowData[i] != 0)
+		{
+			// There's data after the section that would be overwritten.
+			XboxPrintf("File offset 0x%08x after section \"%s\" contains data that would be overwritten!\n", growOffset + i, sectionName.c_str());
+			free(pbGrowData);
+			return false;
+		}
+	}
+
+	// Write the new section data.
+	memset(pbGrowData, 0, growSize);
+	SetFilePointer(this->hFileHandle, growOffset, nullptr, FILE_BEGIN);
+	if (WriteFile(this->hFileHandle, pbGrowData, growSize, &BytesWritten, nullptr) == FALSE || BytesWritten != growSize)
+	{
+		// Failed to write the new section data.
+		XboxPrintf("Failed to write new section data to file!\n");
+		free(pbGrowData);
+		return false;
+	}
+
+	free(pbGrowData);
+
+	// Update the section sizes and the image size so it covers the new end of the section.
+	pSection->VirtualSize = (DWORD)newVirtualSize;
+	pSection->RawSize = (DWORD)newRawSize;
+	this->sHeader.SizeOfImage = max(this->sHeader.SizeOfImage, (DWORD)ALIGN_TO(pSection->VirtualAddress + pSection->VirtualSize - this->sHeader.BaseAddress, 4));
+
+	// Write the new image size.
+	SetFilePointer(this->hFileHandle, FIELD_OFFSET(XBE_IMAGE_HEADER, SizeOfImage), nullptr, FILE_BEGIN);
+	if (WriteFile(this->hFileHandle, &this->sHeader.SizeOfImage, sizeof(DWORD), &BytesWritten, nullptr) == FALSE || BytesWritten != sizeof(DWORD))
+	{
+		// Failed to write the image header.
+		XboxPrintf("Failed to write image header to file!\n");
+		return false;
+	}
+
+	// Update the section digest, this also writes the new section sizes.
+	return UpdateSectionDigest(sectionIndex);
+}
+
+bool XboxExecutable::VerifyExecutable(std::string &report)
+{
+	int errorCount = 0;
+	BYTE abDigest[XBE_IMAGE_DIGEST_LENGTH];
+	BYTE abEmptyDigest[XBE_IMAGE_DIGEST_LENGTH] = { 0 };
+
+	// Check to make sure the executable was loaded and is valid.
+	if (this->bIsValid == false)
+		return false;
+
+	DWORD fileSize = GetFileSize(this->hFileHandle, nullptr);
+	DWORD headersEnd = this->sHeader.BaseAddress + this->sHeader.SizeOfHeaders;
+	DWORD imageEnd = headersEnd;
+
+	// Build lists of the sections sorted by virtual address and raw address so we can check for overlaps.
+	std::vector<int> vVirtualOrder, vRawOrder;
+	for (int i = 0; i < this->sHeader.NumberOfSections; i++)
+	{
+		vVirtualOrder.push_back(i);
+		vRawOrder.push_back(i);
+	}
+
+	std::sort(vVirtualOrder.begin(), vVirtualOrder.end(), [this](int a, int b) { return this->pSectionHeaders[a].VirtualAddress < this->pSectionHeaders[b].VirtualAddress; });
+	std::sort(vRawOrder.begin(), vRawOrder.end(), [this](int a, int b) { return this->pSectionHeaders[a].RawAddress < this->pSectionHeaders[b].RawAddress; });
+
+	// Loop through all the sections and check their address ranges.
+	for (int i = 0; i < this->sHeader.NumberOfSections; i++)
+	{
+		XBE_IMAGE_SECTION_HEADER *pSection = &this->pSectionHeaders[i];
+		const char *psName = this->vSectionHeaderNames.at(i).c_str();
+
+		// Check the section doesn't overlap the image headers in memory.
+		if (pSection->VirtualAddress < headersEnd)
+		{
+			AppendReport(report, "  ERROR: Section %s virtual address 0x%08x overlaps the image headers\n", psName, pSection->VirtualAddress);
+			errorCount++;
+		}
+
+		// Check the section data is within the file and doesn't overlap the image headers.
+		if ((ULONGLONG)pSection->RawAddress + pSection->RawSize > fileSize)
+		{
+			AppendReport(report, "  ERROR: Section %s raw data 0x%08x-0x%08x is past the end of the file\n", psName, pSection->RawAddress, pSection->RawAddress + pSection->RawSize);
+			errorCount++;
+		}
+		else if (pSection->RawSize > 0 && pSection->RawAddress < this->sHeader.SizeOfHeaders)
+		{
+			AppendReport(report, "  ERROR: Section %s raw data 0x%08x overlaps the image headers\n", psName, pSection->RawAddress);
+			errorCount++;
+		}
+
+		// Raw data that is larger than the section will be cut off when loaded.
+		if (pSection->RawSize > pSection->VirtualSize)
+			AppendReport(report, "  WARNING: Section %s raw size 0x%08x is larger than its virtual size 0x%08x\n", psName, pSection->RawSize, pSection->VirtualSize);
+
+		// Check the shared page counters are within the image headers.
+		if (XBE_HEADER_RANGE_VALID(&this->sHeader, pSection->HeadSharedPageReferenceCount, sizeof(WORD)) == false ||
+			XBE_HEADER_RANGE_VALID(&this->sHeader, pSection->TailSharedPageReferenceCount, sizeof(WORD)) == false)
+		{
+			AppendReport(report, "  ERROR: Section %s shared page counters are outside of the image headers\n", psName);
+			errorCount++;
+		}
+
+		// Track the end of the image.
+		if (pSection->VirtualAddress + pSection->VirtualSize > imageEnd)
+			imageEnd = pSection->VirtualAddress + pSection->VirtualSize;
+	}
+
+	// Check for sections that overlap in memory.
+	for (size_t i = 1; i < vVirtualOrder.size(); i++)
+	{
+		XBE_IMAGE_SECTION_HEADER *pPrevious = &this->pSectionHeaders[vVirtualOrder[i - 1]];
+		XBE_IMAGE_SECTION_HEADER *pSection = &this->pSectionHeaders[vVirtualOrder[i]];
+		if ((ULONGLONG)pPrevious->VirtualAddress + pPrevious->VirtualSize > pSection->VirtualAddress)
+		{
+			AppendReport(report, "  ERROR: Sections %s and %s overlap in memory\n", this->vSectionHeaderNames.at(vVirtualOrder[i - 1]).c_str(),
+				this->vSectionHeaderNames.at(vVirtualOrder[i]).c_str());
+			errorCount++;
+		}
+
+		// The loader expects sections to be in ascending address order.
+		if (vVirtualOrder[i] != vVirtualOrder[i - 1] + 1)
+			AppendReport(report, "  WARNING: Section %s is not in ascending virtual address order\n", this->vSectionHeaderNames.at(vVirtualOrder[i]).c_str());
+	}
+
+	// Check for sections that overlap in the file.
+	for (size_t i = 1; i < vRawOrder.size(); i++)
+	{
+		XBE_IMAGE_SECTION_HEADER *pPrevious = &this->pSectionHeaders[vRawOrder[i - 1]];
+		XBE_IMAGE_SECTION_HEADER *pSection = &this->pSectionHeaders[vRawOrder[i]];
+		if (pPrevious->RawSize > 0 && pSection->RawSize > 0 && (ULONGLONG)pPrevious->RawAddress + pPrevious->RawSize > pSection->RawAddress)
+		{
+			AppendReport(report, "  ERROR: Sections %s and %s overlap in the file\n", this->vSectionHeaderNames.at(vRawOrder[i - 1]).c_str(),
+				this->vSectionHeaderNames.at(vRawOrder[i]).c_str());
+			errorCount++;
+		}
+	}
+
+	// Check the image size covers all of the sections.
+	if (this->sHeader.SizeOfImage < imageEnd - this->sHeader.BaseAddress)
+	{
+		AppendReport(report, "  ERROR: SizeOfImage 0x%08x is smaller than the end of the last section 0x%08x\n", this->sHeader.SizeOfImage, imageEnd - this->sHeader.BaseAddress);
+		errorCount++;
+	}
+
+	// Check the shared page counters. Sections that share a page must share the counter for it or the page can be freed while the other
+	// section is still using it, and a section that spans multiple pages needs separate head and tail counters. Sharing a counter without
+	// sharing a page only keeps a page committed longer than needed. The counter assignment assumes ascending address order so skip this if
+	// the sections are out of order.
+	std::vector<int> vHeadCounterIndex, vTailCounterIndex;
+	CalculateSharedPageCounters(vHeadCounterIndex, vTailCounterIndex);
+	bool sectionsInOrder = std::is_sorted(vVirtualOrder.begin(), vVirtualOrder.end());
+	for (int i = 0; i < this->sHeader.NumberOfSections && sectionsInOrder == true; i++)
+	{
+		XBE_IMAGE_SECTION_HEADER *pSection = &this->pSectionHeaders[i];
+		const char *psName = this->vSectionHeaderNames.at(i).c_str();
+
+		// Check the head and tail page counters.
+		if (vHeadCounterIndex[i] != vTailCounterIndex[i] && pSection->HeadSharedPageReferenceCount == pSection->TailSharedPageReferenceCount)
+		{
+			AppendReport(report, "  ERROR: Section %s uses the same counter for its head and tail pages\n", psName);
+			errorCount++;
+		}
+
+		// Check the head page counter against the previous section's tail page counter.
+		if (i == 0)
+			continue;
+
+		bool sharesPage = vHeadCounterIndex[i] == vTailCounterIndex[i - 1];
+		bool sharesCounter = pSection->HeadSharedPageReferenceCount == this->pSectionHeaders[i - 1].TailSharedPageReferenceCount;
+		if (sharesPage == true && sharesCounter == false)
+		{
+			AppendReport(report, "  ERROR: Section %s shares a page with section %s but not its page counter\n", psName, this->vSectionHeaderNames.at(i - 1).c_str());
+			errorCount++;
+		}
+		else if (sharesPage == false && sharesCounter == true)
+			AppendReport(report, "  WARNING: Section %s shares a page counter with section %s but not a page\n", psName, this->vSectionHeaderNames.at(i - 1).c_str());
+	}
+
+	// Loop through all the sections and check the section digests.
+	for (int i = 0; i < this->sHeader.NumberOfSections; i++)
+	{
+		XBE_IMAGE_SECTION_HEADER *pSection = &this->pSectionHeaders[i];
+
+		// Skip sections we already know have bad raw data.
+		if ((ULONGLONG)pSection->RawAddress + pSection->RawSize > fileSize)
+			continue;
+
+		if (CalculateSectionDigest(i, abDigest) == false)
+		{
+			AppendReport(report, "  ERROR: Failed to calculate digest for section %s\n", this->vSectionHeaderNames.at(i).c_str());
+			errorCount++;
+		}
+		else if (memcmp(abDigest, pSection->SectionDigest, XBE_IMAGE_DIGEST_LENGTH) != 0)
+		{
+			// Sections added by this tool don't have a digest, so only treat it as an error if the digest was set.
+			if (memcmp(abEmptyDigest, pSection->SectionDigest, XBE_IMAGE_DIGEST_LENGTH) == 0)
+				AppendReport(report, "  WARNING: Section %s has no digest\n", this->vSectionHeaderNames.at(i).c_str());
+			else
+			{
+				AppendReport(report, "  ERROR: Section %s digest does not match the section data\n", this->vSectionHeaderNames.at(i).c_str());
+				errorCount++;
+			}
+		}
+	}
+
+	return errorCount == 0;
+}
+
+bool XboxExecutable::CalculateSectionDigest(int sectionIndex, BYTE *pbDigest)
+{
+	DWORD BytesRead = 0;
+	XboxSHA1Hash hash;
+	XBE_IMAGE_SECTION_HEADER *pSection = &this->pSectionHeaders[sectionIndex];
+
+	// The section digest covers the raw size of the section followed by the raw data.
+	if (hash.Initialize() == false || hash.HashData((BYTE*)&pSection->RawSize, sizeof(DWORD)) == false)
+		return false;
+
+	// Allocate a buffer to read the section data into.
+	BYTE *pbChunk = (BYTE*)malloc(XBE_SECTION_DIGEST_CHUNK_SIZE);
+	if (pbChunk == nullptr)
+		return false;
+
+	// Loop and hash the section data in chunks.
+	DWORD bytesRemaining = pSection->RawSize;
+	SetFilePointer(this->hFileHandle, pSection->RawAddress, nullptr, FILE_BEGIN);
+	while (bytesRemaining > 0)
+	{
+		DWORD chunkSize = min(bytesRemaining, (DWORD)XBE_SECTION_DIGEST_CHUNK_SIZE);
+		if (ReadFile(this->hFileHandle, pbChunk, chunkSize, &BytesRead, nullptr) == FALSE || BytesRead != chunkSize ||
+			hash.HashData(pbChunk, chunkSize) == false)
+			break;
+
+		bytesRemaining -= chunkSize;
+	}
+
+	free(pbChunk);
+
+	// Get the digest if all the data was hashed.
+	return bytesRemaining == 0 && hash.GetDigest(pbDigest) == true;
+}
+
+bool XboxExecutable::UpdateSectionDigest(int sectionIndex)
+{
+	DWORD BytesWritten = 0;
+	XBE_IMAGE_SECTION_HEADER *pSection = &this->pSectionHeaders[sectionIndex];
+
+	// Calculate the digest of the section data as it is now in the file.
+	if (CalculateSectionDigest(sectionIndex, (BYTE*)pSection->SectionDigest) == false)
+	{
+		// Failed to calculate the section digest.
+		XboxPrintf("Failed to calculate digest for section \"%s\"!\n", this->vSectionHeaderNames.at(sectionIndex).c_str());
+		return false;
+	}
+
+	// Seek to the section header and write the updated digest.
+	SetFilePointer(this->hFileHandle, XBE_HEADER_OFFSET_OF(&this->sHeader, this->sHeader.SectionHeadersAddress) +
+		(sectionIndex * sizeof(XBE_IMAGE_SECTION_HEADER)), nullptr, FILE_BEGIN);
+	if (WriteFile(this->hFileHandle, pSection, sizeof(XBE_IMAGE_SECTION_HEADER), &BytesWritten, nullptr) == FALSE || BytesWritten != sizeof(XBE_IMAGE_SECTION_HEADER))
+	{
+		// Failed to write the section header.
+		XboxPrintf("Failed to write section header to file!\n");
+		return false;
+	}
+
+	return true;
+}
+
+void XboxExecutable::AppendReport(std::string &report, const char *psFormat, ...)
+{
+	char szBuffer[512];
+	va_list args;
+
+	// Format the message and add it to the report.
+	va_start(args, psFormat);
+	vsnprintf(szBuffer, sizeof(szBuffer), psFormat, args);
+	va_end(args);
+
+	report += szBuffer;
+}
+
+int XboxExecutable::FindSection(std::string sectionName)
+{
+	// Loop through all the sections and find the one with a matching name.
+	for (int i = 0; i < this->sHeader.NumberOfSections; i++)
+	{
+		if (this->vSectionHeaderNames.at(i) == sectionName)
+			return i;
+	}
+
+	return -1;
+}
+
+bool XboxExecutable::WriteSectionData(std::string sectionName, const BYTE *pbData, DWORD dataSize)
+{
+	DWORD BytesWritten = 0;
+
+	// Check to make sure the executable was loaded and is valid.
+	if (this->bIsValid == false)
+		return false;
+
+	// Find the section to write to.
+	int sectionIndex = FindSection(sectionName);
+	if (sectionIndex == -1)
+	{
+		// Section not found.
+		XboxPrintf("Section \"%s\" not found!\n", sectionName.c_str());
+		return false;
+	}
+
+	// Make sure the data will fit in the section.
+	XBE_IMAGE_SECTION_HEADER *pSection = &this->pSectionHeaders[sectionIndex];
+	if (dataSize > pSection->RawSize)
+	{
+		// Data is too large for the section.
+		XboxPrintf("Data size 0x%08x is larger than section \"%s\" (0x%08x)!\n", dataSize, sectionName.c_str(), pSection->RawSize);
+		return false;
+	}
+
+	// Allocate a buffer for the section data, anything past the new data is cleared so nothing is left over from a larger payload
+	// that was written before.
+	BYTE *pbSectionData = (BYTE*)malloc(pSection->RawSize);
+	if (pbSectionData == nullptr)
+	{
+		// Failed to allocate memory for the section data.
+		XboxPrintf("Failed to allocate memory for section data!\n");
+		return false;
+	}
+
+	memcpy(pbSectionData, pbData, dataSize);
+	memset(pbSectionData + dataSize, 0, pSection->RawSize - dataSize);
+
+	// Seek to the section data and write the new data.
+	SetFilePointer(this->hFileHandle, pSection->RawAddress, nullptr, FILE_BEGIN);
+	if (WriteFile(this->hFileHandle, pbSectionData, pSection->RawSize, &BytesWritten, nullptr) == FALSE || BytesWritten != pSection->RawSize)
+	{
+		// Failed to write the section data.
+		XboxPrintf("Failed to write section data to file!\n");
+		free(pbSectionData);
+		return false;
+	}
+
+	free(pbSectionData);
+
+	// Update the section digest to match the new data.
+	return UpdateSectionDigest(sectionIndex);
+}
+
+bool XboxExecutable::WriteVirtualData(DWORD virtualAddress, const BYTE *pbData, DWORD dataSize)
+{
+	DWORD BytesWritten = 0;
+
+	// Check to make sure the executable was loaded and is valid.
+	if (this->bIsValid == false)
+		return false;
+
+	// Loop through all the sections and find the one that contains the address range.
+	for (int i = 0; i < this->sHeader.NumberOfSections; i++)
+	{
+		XBE_IMAGE_SECTION_HEADER *pSection = &this->pSectionHeaders[i];
+
+		// Only the part of the section that is backed by file data can be written to.
+		if (virtualAddress < pSection->VirtualAddress || (ULONGLONG)virtualAddress + dataSize > (ULONGLONG)pSection->VirtualAddress + pSection->RawSize)
+			continue;
+
+		// Seek to the file offset of the address and write the new data.
+		SetFilePointer(this->hFileHandle, pSection->RawAddress + (virtualAddress - pSection->VirtualAddress), nullptr, FILE_BEGIN);
+		if (WriteFile(this->hFileHandle, pbData, dataSize, &BytesWritten, nullptr) == FALSE || BytesWritten != dataSize)
+		{
+			// Failed to write the data.
+			XboxPrintf("Failed to write data to file!\n");
+			return false;
+		}
+
+		// Update the section digest to match the new data.
+		return UpdateSectionDigest(i);
+	}
+
+	// Address range is not in the file data of any section.
+	XboxPrintf("Address range 0x%08x-0x%08x is not backed by section data!\n", virtualAddress, virtualAddress + dataSize);
+	return false;
+}
+
+void XboxExecutable::PrintMemoryReport(DWORD ramBudget)
+{
+	DWORD preloadSectionCount = 0;
+	DWORD preloadVirtualSize = 0;
+	DWORD preloadCommittedSize = 0;
+	DWORD onDemandSectionCount = 0;
+	DWORD onDemandVirtualSize = 0;
+	DWORD lastCommittedPage = 0;
+
+	// Check to make sure the executable was loaded and is valid.
+	if (this->bIsValid == false)
+		return;
+
+	// Loop through all the sections and total up how much memory they use. Sections are laid out in ascending
+	// virtual address order so we only need to check the previous section for a shared head page.
+	for (int i = 0; i < this->sHeader.NumberOfSections; i++)
+	{
+		XBE_IMAGE_SECTION_HEADER *pSection = &this->pSectionHeaders[i];
+
+		// Sections that are not preloaded are only committed when the title loads them.
+		if ((pSection->SectionFlags & XBE_SECTION_FLAGS_PRELOAD) == 0)
+		{
+			onDemandSectionCount++;
+			onDemandVirtualSize += pSection->VirtualSize;
+			continue;
+		}
+
+		preloadSectionCount++;
+		preloadVirtualSize += pSection->VirtualSize;
+
+		// Calculate the range of pages the section occupies, skipping the head page if it was already committed by
+		// the previous section.
+		DWORD startPage = pSection->VirtualAddress & ~(XBOX_PAGE_SIZE - 1);
+		DWORD endPage = ALIGN_TO(pSection->VirtualAddress + pSection->VirtualSize, XBOX_PAGE_SIZE);
+		if (startPage < lastCommittedPage)
+			startPage = lastCommittedPage;
+
+		if (endPage > startPage)
+		{
+			preloadCommittedSize += endPage - startPage;
+			lastCommittedPage = endPage;
+		}
+	}
+
+	// The image headers are mapped in for the life of the title as well.
+	DWORD headersCommittedSize = ALIGN_TO(this->sHeader.SizeOfHeaders, XBOX_PAGE_SIZE);
+	DWORD totalCommittedSize = headersCommittedSize + preloadCommittedSize;
+
+	// Print the memory report.
+	XboxPrintf("Preloaded Sections: \t%d (0x%08x bytes)\n", preloadSectionCount, preloadVirtualSize);
+	XboxPrintf("On Demand Sections: \t%d (0x%08x bytes)\n", onDemandSectionCount, onDemandVirtualSize);
+	XboxPrintf("Committed At Boot: \t0x%08x (headers 0x%08x, sections 0x%08x)\n", totalCommittedSize, headersCommittedSize, preloadCommittedSize);
+	XboxPrintf("Page Alignment Waste: \t0x%08x\n", preloadCommittedSize - preloadVirtualSize);
+	XboxPrintf("Size Of Image: \t\t0x%08x (+0x%08x)\n\n", this->sHeader.SizeOfImage, this->sHeader.SizeOfImage - this->originalSizeOfImage);
+
+	// Check if the image exceeds the memory budget.
+	if (ramBudget > 0 && totalCommittedSize > ramBudget)
+	{
+		XboxPrintf("WARNING: Image commits 0x%08x bytes at boot which exceeds the memory budget of 0x%08x bytes! Consider marking large sections as not preloaded.\n\n",
+			totalCommittedSize, ramBudget);
+	}
+}
+
 DWORD XboxExecutable::FindImageDataStartOffset()
 {
 	DWORD lowestOffset = 0xFFFFFFFF;
@@ -568,4 +1323,188 @@ DWORD XboxExecutable::FindImageDataStartOffset()
 	}
 
 	return lowestOffset;
-}
\ No newline at end of file
+}
+
+DWORD XboxExecutable::FindImageDataEndOffset()
+{
+	DWORD highestOffset = 0;
+
+	// Loop through all the sections and find the highest image offset.
+	for (int i = 0; i < this->sHeader.NumberOfSections; i++)
+	{
+		// Check if this section ends after the highest we've seen so far.
+		if (this->pSectionHeaders[i].RawAddress + this->pSectionHeaders[i].RawSize > highestOffset)
+			highestOffset = this->pSectionHeaders[i].RawAddress + this->pSectionHeaders[i].RawSize;
+	}
+
+	return highestOffset;
+}
+
+int XboxExecutable::CalculateSharedPageCounters(std::vector<int> &vHeadCounterIndex, std::vector<int> &vTailCounterIndex)
+{
+	int counterCount = 0;
+	DWORD previousTailPage = 0;
+
+	vHeadCounterIndex.resize(this->sHeader.NumberOfSections);
+	vTailCounterIndex.resize(this->sHeader.NumberOfSections);
+
+	// Loop through all the sections and assign the shared page counters. A section shares its head page counter with
+	// the previous section's tail page counter only if they actually occupy the same page, and a section that fits
+	// in a single page uses the same counter for its head and tail page.
+	for (int i = 0; i < this->sHeader.NumberOfSections; i++)
+	{
+		DWORD virtualSize = max(this->pSectionHeaders[i].VirtualSize, (DWORD)1);
+		DWORD headPage = this->pSectionHeaders[i].VirtualAddress & ~(XBOX_PAGE_SIZE - 1);
+		DWORD tailPage = (this->pSectionHeaders[i].VirtualAddress + virtualSize - 1) & ~(XBOX_PAGE_SIZE - 1);
+
+		// Check if the head page is shared with the previous section.
+		if (i > 0 && headPage == previousTailPage)
+			vHeadCounterIndex[i] = vTailCounterIndex[i - 1];
+		else
+			vHeadCounterIndex[i] = counterCount++;
+
+		// Check if the tail page is the same as the head page.
+		if (tailPage == headPage)
+			vTailCounterIndex[i] = vHeadCounterIndex[i];
+		else
+			vTailCounterIndex[i] = counterCount++;
+
+		previousTailPage = tailPage;
+	}
+
+	return counterCount;
+}
+
+bool ParseSectionFlags(const char *psFlags, DWORD *pSectionFlags)
+{
+	DWORD sectionFlags = 0;
+
+	// Loop and parse each flag character.
+	for (const char *p = psFlags; *p != 0; p++)
+	{
+		switch (tolower(*p))
+		{
+		case 'w': sectionFlags |= XBE_SECTION_FLAGS_WRITABLE; break;
+		case 'p': sectionFlags |= XBE_SECTION_FLAGS_PRELOAD; break;
+		case 'x': sectionFlags |= XBE_SECTION_FLAGS_EXECUTABLE; break;
+		default:
+			{
+				// Unknown flag.
+				XboxPrintf("Unknown section flag '%c'\n\n", *p);
+				return false;
+			}
+		}
+	}
+
+	*pSectionFlags = sectionFlags;
+	return true;
+}
+
+void XboxPrintf(const char *psFormat, ...)
+{
+	va_list args;
+
+	// Check if output for this thread is being captured.
+	va_start(args, psFormat);
+	if (pCapturedOutput != nullptr)
+	{
+		// Format the message and add it to the captured output.
+		va_list argsCopy;
+		va_copy(argsCopy, args);
+		int length = vsnprintf(nullptr, 0, psFormat, argsCopy);
+		va_end(argsCopy);
+
+		if (length > 0)
+		{
+			size_t offset = pCapturedOutput->size();
+			pCapturedOutput->resize(offset + length + 1);
+			vsnprintf(&(*pCapturedOutput)[offset], length + 1, psFormat, args);
+			pCapturedOutput->resize(offset + length);
+		}
+	}
+	else
+		vprintf(psFormat, args);
+
+	va_end(args);
+}
+
+void CaptureOutput(std::string *pOutput)
+{
+	// Set the buffer output for this thread is written to.
+	pCapturedOutput = pOutput;
+}
+
+bool ParseSectionSize(const char *psSize, DWORD *pSectionSize)
+{
+	char *pEnd = nullptr;
+
+	// Parse the size and make sure the whole string was used.
+	unsigned long sectionSize = strtoul(psSize, &pEnd, 10);
+	if (*psSize == 0 || *pEnd != 0 || sectionSize == 0 || sectionSize > XBE_SECTION_MAX_SIZE)
+	{
+		// Invalid section size.
+		XboxPrintf("Invalid section size \"%s\", must be between 1 and %d bytes\n\n", psSize, XBE_SECTION_MAX_SIZE);
+		return false;
+	}
+
+	*pSectionSize = (DWORD)sectionSize;
+	return true;
+}
+
+bool CalculateSHA1Digest(const BYTE *pbData, DWORD dataLength, BYTE *pbDigest)
+{
+	XboxSHA1Hash hash;
+
+	// Hash the data and get the digest.
+	return hash.Initialize() == true && hash.HashData(pbData, dataLength) == true && hash.GetDigest(pbDigest) == true;
+}
+
+XboxSHA1Hash::XboxSHA1Hash()
+{
+	// Initialize fields.
+	this->hProvider = NULL;
+	this->hHash = NULL;
+}
+
+XboxSHA1Hash::~XboxSHA1Hash()
+{
+	// Release the hash and crypto provider if they were created.
+	if (this->hHash != NULL)
+		CryptDestroyHash(this->hHash);
+
+	if (this->hProvider != NULL)
+		CryptReleaseContext(this->hProvider, 0);
+}
+
+bool XboxSHA1Hash::Initialize()
+{
+	// Acquire a crypto provider we can use for hashing.
+	if (CryptAcquireContext(&this->hProvider, nullptr, nullptr, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT) == FALSE)
+	{
+		this->hProvider = NULL;
+		return false;
+	}
+
+	// Create the hash object.
+	if (CryptCreateHash(this->hProvider, CALG_SHA1, 0, 0, &this->hHash) == FALSE)
+	{
+		this->hHash = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+bool XboxSHA1Hash::HashData(const BYTE *pbData, DWORD dataLength)
+{
+	// Add the data to the hash.
+	return this->hHash != NULL && CryptHashData(this->hHash, pbData, dataLength, 0) == TRUE;
+}
+
+bool XboxSHA1Hash::GetDigest(BYTE *pbDigest)
+{
+	DWORD digestLength = XBE_IMAGE_DIGEST_LENGTH;
+
+	// Finish the hash and get the digest.
+	return this->hHash != NULL && CryptGetHashParam(this->hHash, HP_HASHVAL, pbDigest, &digestLength, 0) == TRUE;
+}
@@ -34,8 +34,25 @@
 
 #define XBE_HEADER_OFFSET_OF(header, addr)		(addr - (header)->BaseAddress)
 
+#define XBE_HEADER_RANGE_VALID(header, addr, size)	((addr) >= (header)->BaseAddress && (ULONGLONG)((addr) - (header)->BaseAddress) + (size) <= (header)->SizeOfHeaders)
+
 #define XBE_HEADER_ADDRESS_OF(header, ptr)		(((DWORD)((char*)(ptr) - (char*)header)) + (header)->BaseAddress)
 
+#define XBOX_PAGE_SIZE				0x1000
+
+// Size of the chunks section data is read in when calculating section digests.
+#define XBE_SECTION_DIGEST_CHUNK_SIZE	0x10000
+
+// Minimum alignment for section raw data when using the packed layout. Only the virtual address of a section needs
+// to be page aligned, the loader reads the raw data into place from any file offset.
+#define XBE_SECTION_RAW_PACKED_ALIGNMENT	4
+
+// Total amount of RAM in a retail console, used as the default memory budget.
+#define XBOX_RETAIL_RAM_SIZE		(64 * 1024 * 1024)
+
+// Largest section that can be added to an image, the amount of RAM in a development kit.
+#define XBE_SECTION_MAX_SIZE		(128 * 1024 * 1024)
+
 #define ALIGN_TO(addr, align)		((size_t)(addr) + (((size_t)(addr) % align) == 0 ? 0 : align - ((size_t)(addr) % align)))
 
 struct XBE_IMAGE_HEADER
@@ -108,6 +125,9 @@ struct XBE_IMAGE_CERTIFICATE
 #define XBE_SECTION_FLAGS_HEAD_PAGE_READ_ONLY	0x00000010
 #define XBE_SECTION_FLAGS_TAIL_PAGE_READ_ONLY	0x00000020
 
+// Default flags for sections added to the image.
+#define XBE_SECTION_FLAGS_HACKS_DEFAULT			(XBE_SECTION_FLAGS_WRITABLE | XBE_SECTION_FLAGS_PRELOAD | XBE_SECTION_FLAGS_EXECUTABLE)
+
 struct XBE_IMAGE_SECTION_HEADER
 {
 	/* 0x00 */ DWORD		SectionFlags;
@@ -137,6 +157,38 @@ struct XBE_IMAGE_IMPORT_DESCRIPTOR
 	/* 0x04 */ DWORD		ModuleNameAddress;
 };
 
+// ---------------------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------------------
+
+bool ParseSectionFlags(const char *psFlags, DWORD *pSectionFlags);
+bool ParseSectionSize(const char *psSize, DWORD *pSectionSize);
+
+bool CalculateSHA1Digest(const BYTE *pbData, DWORD dataLength, BYTE *pbDigest);
+
+// Prints to the console, or to the calling thread's capture buffer if one is set. Used for output that may come from several
+// files being processed at once so each file's output can be printed together.
+void XboxPrintf(const char *psFormat, ...);
+void CaptureOutput(std::string *pOutput);
+
+// ---------------------------------------------------------------------------------------
+// XboxSHA1Hash
+// ---------------------------------------------------------------------------------------
+class XboxSHA1Hash
+{
+private:
+	HCRYPTPROV					hProvider;
+	HCRYPTHASH					hHash;
+
+public:
+	XboxSHA1Hash();
+	~XboxSHA1Hash();
+
+	bool Initialize();
+	bool HashData(const BYTE *pbData, DWORD dataLength);
+	bool GetDigest(BYTE *pbDigest);
+};
+
 // ---------------------------------------------------------------------------------------
 // XboxExecutable
 // ---------------------------------------------------------------------------------------
@@ -148,6 +200,7 @@ private:
 
 	bool						bIsValid;
 	XBE_IMAGE_HEADER			sHeader;
+	DWORD						originalSizeOfImage;
 	XBE_IMAGE_CERTIFICATE		sCertificate;
 
 	XBE_IMAGE_SECTION_HEADER	*pSectionHeaders;
@@ -164,12 +217,34 @@ private:
 	BYTE						*pbLogoBitmap;
 
 	DWORD FindImageDataStartOffset();
+	DWORD FindImageDataEndOffset();
+
+	int CalculateSharedPageCounters(std::vector<int> &vHeadCounterIndex, std::vector<int> &vTailCounterIndex);
+	bool CalculateSectionDigest(int sectionIndex, BYTE *pbDigest);
+	bool UpdateSectionDigest(int sectionIndex);
+
+	static void AppendReport(std::string &report, const char *psFormat, ...);
 
 public:
 	XboxExecutable(std::string fileName);
 	~XboxExecutable();
 
-	bool ReadExecutable();
+	bool ReadExecutable(bool readOnly);
+
+	bool AddSectionForHacks(std::string sectionName, DWORD sectionSize, DWORD sectionFlags, bool packedLayout);
+	bool ExtendSection(std::string sectionName, DWORD additionalSize);
+
+	void PrintMemoryReport(DWORD ramBudget);
+
+	bool VerifyExecutable(std::string &report);
+
+	int FindSection(std::string sectionName);
+	bool WriteSectionData(std::string sectionName, const BYTE *pbData, DWORD dataSize);
+	bool WriteVirtualData(DWORD virtualAddress, const BYTE *pbData, DWORD dataSize);
+
+	int GetSectionCount() { return this->sHeader.NumberOfSections; }
+	const XBE_IMAGE_SECTION_HEADER *GetSectionHeader(int index) { return &this->pSectionHeaders[index]; }
+	std::string GetSectionName(int index) { return this->vSectionHeaderNames.at(index); }
 
-	bool AddSectionForHacks(std::string sectionName, int sectionSize);
+	HANDLE GetFileHandle() { return this->hFileHandle; }
 };
\ No newline at end of file
@@ -0,0 +1,503 @@
+/*
+	XboxImageXploder - Utility for modifying xbox executables.
+
+	XboxImageDaemon.cpp - Types and functions for keeping xbox executables resident and modifying them on request.
+
+	Author - Grimdoomer
+*/
+
+#include "XboxImageDaemon.h"
+
+XboxImageDaemon::XboxImageDaemon(std::string pipeName) : sPipeName(), mExecutables(), vWatches()
+{
+	// Initialize fields.
+	this->sPipeName = XBOX_DAEMON_PIPE_PREFIX + pipeName;
+	this->bRunning = false;
+
+	InitializeCriticalSection(&this->sLock);
+}
+
+XboxImageDaemon::~XboxImageDaemon()
+{
+	// Close all the executables we still have open.
+	for (auto iter = this->mExecutables.begin(); iter != this->mExecutables.end(); iter++)
+		delete iter->second;
+
+	DeleteCriticalSection(&this->sLock);
+}
+
+bool XboxImageDaemon::Run()
+{
+	DWORD BytesRead = 0;
+	DWORD BytesWritten = 0;
+	char szCommand[XBOX_DAEMON_MAX_COMMAND_SIZE + 1];
+
+	// Create the named pipe clients will send commands over. Commands can read and write any file the daemon can so only accept
+	// clients on this machine.
+	HANDLE hPipe = CreateNamedPipeA(this->sPipeName.c_str(), PIPE_ACCESS_DUPLEX, PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+		1, XBOX_DAEMON_MAX_RESPONSE_SIZE, XBOX_DAEMON_MAX_COMMAND_SIZE, 0, nullptr);
+	if (hPipe == INVALID_HANDLE_VALUE)
+	{
+		// Failed to create the pipe.
+		printf("Failed to create pipe \"%s\": %d\n", this->sPipeName.c_str(), GetLastError());
+		return false;
+	}
+
+	// Start the thread that watches payload files for changes.
+	this->bRunning = true;
+	HANDLE hWatchThread = CreateThread(nullptr, 0, WatchThreadProc, this, 0, nullptr);
+	if (hWatchThread == NULL)
+	{
+		// Failed to create the watch thread.
+		printf("Failed to create watch thread: %d\n", GetLastError());
+		CloseHandle(hPipe);
+		return false;
+	}
+
+	printf("Listening for commands on %s\n\n", this->sPipeName.c_str());
+
+	// Loop and process commands until we are told to quit.
+	while (this->bRunning == true)
+	{
+		// Wait for a client to connect.
+		if (ConnectNamedPipe(hPipe, nullptr) == FALSE && GetLastError() != ERROR_PIPE_CONNECTED)
+		{
+			// Failed to connect to the client.
+			printf("Failed to connect to client: %d\n", GetLastError());
+			continue;
+		}
+
+		// Read the command from the client.
+		if (ReadFile(hPipe, szCommand, XBOX_DAEMON_MAX_COMMAND_SIZE, &BytesRead, nullptr) == TRUE)
+		{
+			// Execute the command.
+			szCommand[BytesRead] = 0;
+			std::string response = ExecuteCommand(szCommand);
+
+			// Send the response back to the client.
+			DWORD responseSize = (DWORD)min(response.size(), (size_t)XBOX_DAEMON_MAX_RESPONSE_SIZE);
+			if (WriteFile(hPipe, response.c_str(), responseSize, &BytesWritten, nullptr) == TRUE)
+				FlushFileBuffers(hPipe);
+		}
+
+		// Disconnect so the next client can connect.
+		DisconnectNamedPipe(hPipe);
+	}
+
+	// Wait for the watch thread to exit.
+	WaitForSingleObject(hWatchThread, INFINITE);
+	CloseHandle(hWatchThread);
+	CloseHandle(hPipe);
+
+	return true;
+}
+
+bool XboxImageDaemon::SendCommand(std::string pipeName, std::string command)
+{
+	DWORD BytesRead = 0;
+	char *pResponse = (char*)malloc(XBOX_DAEMON_MAX_RESPONSE_SIZE + 1);
+	if (pResponse == nullptr)
+	{
+		// Failed to allocate memory for the response.
+		printf("Failed to allocate memory for response!\n");
+		return false;
+	}
+
+	// Send the command to the daemon and wait for the response.
+	std::string fullPipeName = XBOX_DAEMON_PIPE_PREFIX + pipeName;
+	if (CallNamedPipeA(fullPipeName.c_str(), (LPVOID)command.c_str(), (DWORD)command.size(), pResponse, XBOX_DAEMON_MAX_RESPONSE_SIZE,
+		&BytesRead, XBOX_DAEMON_CLIENT_TIMEOUT) == FALSE && GetLastError() != ERROR_MORE_DATA)
+	{
+		// Failed to send the command.
+		printf("Failed to send command to \"%s\": %d\n", fullPipeName.c_str(), GetLastError());
+		free(pResponse);
+		return false;
+	}
+
+	// Print the response.
+	pResponse[BytesRead] = 0;
+	printf("%s", pResponse);
+
+	bool result = strncmp(pResponse, "OK", 2) == 0;
+	free(pResponse);
+
+	return result;
+}
+
+DWORD WINAPI XboxImageDaemon::WatchThreadProc(LPVOID lpParameter)
+{
+	XboxImageDaemon *pDaemon = (XboxImageDaemon*)lpParameter;
+
+	// Poll the watched payload files until the daemon is stopped.
+	while (pDaemon->bRunning == true)
+	{
+		pDaemon->PollWatches();
+		Sleep(XBOX_DAEMON_WATCH_INTERVAL);
+	}
+
+	return 0;
+}
+
+void XboxImageDaemon::PollWatches()
+{
+	WIN32_FILE_ATTRIBUTE_DATA sFileInfo;
+
+	EnterCriticalSection(&this->sLock);
+
+	// Loop through all the watched payloads and check if any have changed.
+	for (size_t i = 0; i < this->vWatches.size(); i++)
+	{
+		XBOX_DAEMON_WATCH *pWatch = &this->vWatches[i];
+
+		// Check if the payload file has been written to since we last injected it.
+		if (GetFileAttributesExA(pWatch->sPayloadFileName.c_str(), GetFileExInfoStandard, &sFileInfo) == FALSE ||
+			CompareFileTime(&sFileInfo.ftLastWriteTime, &pWatch->ftLastWriteTime) == 0)
+			continue;
+
+		// Read the payload. If this fails the file is most likely still being written, so leave the write time alone
+		// and try again on the next poll.
+		std::vector<BYTE> vPayload;
+		if (ReadPayloadFile(pWatch->sPayloadFileName, vPayload) == false)
+			continue;
+
+		// Re-inject the payload. Any failure from here on won't go away by retrying, so record the write time either way and
+		// only report it once per change to the payload.
+		std::string response;
+		pWatch->ftLastWriteTime = sFileInfo.ftLastWriteTime;
+		WritePayload(pWatch->sFileName, pWatch->sSectionName, pWatch->sPayloadFileName, vPayload, response);
+
+		printf("%s", response.c_str());
+	}
+
+	LeaveCriticalSection(&this->sLock);
+}
+
+std::string XboxImageDaemon::ExecuteCommand(std::string command)
+{
+	std::string response;
+
+	// Split the command into its arguments.
+	std::vector<std::string> vArgs = SplitCommand(command);
+	if (vArgs.size() == 0)
+		return "ERROR: No command\n";
+
+	EnterCriticalSection(&this->sLock);
+
+	// Capture anything printed while running the command so the details of any failure are sent back to the client.
+	std::string output;
+	CaptureOutput(&output);
+
+	const std::string &name = vArgs[0];
+	if (name == "open" && vArgs.size() == 2)
+	{
+		// Open the executable and keep it resident.
+		if (OpenExecutable(vArgs[1], response) != nullptr)
+			response = "OK\n";
+	}
+	else if (name == "close" && vArgs.size() == 2)
+	{
+		// Find the executable and close it.
+		if (CloseExecutable(vArgs[1]) == true)
+			response = "OK\n";
+		else
+			response = "ERROR: Executable is not open\n";
+	}
+	else if (name == "add" && vArgs.size() >= 4 && vArgs.size() <= 6)
+	{
+		DWORD sectionFlags = XBE_SECTION_FLAGS_HACKS_DEFAULT;
+		DWORD sectionSize = 0;
+		bool packedLayout = false;
+
+		// Parse the section size.
+		if (ParseSectionSize(vArgs[3].c_str(), &sectionSize) == false)
+			response = "ERROR: Invalid section size\n";
+
+		// Parse the optional section flags and layout.
+		for (size_t i = 4; i < vArgs.size(); i++)
+		{
+			if (vArgs[i] == "packed")
+				packedLayout = true;
+			else if (ParseSectionFlags(vArgs[i].c_str(), &sectionFlags) == false)
+				response = "ERROR: Invalid section flags\n";
+		}
+
+		// Add the new section to the executable.
+		XboxExecutable *pXbe = nullptr;
+		if (response.empty() == true && (pXbe = OpenExecutable(vArgs[1], response)) != nullptr)
+		{
+			if (pXbe->AddSectionForHacks(vArgs[2], sectionSize, sectionFlags, packedLayout) == true)
+				response = "OK\n" + FormatLayout(pXbe);
+			else
+			{
+				// The section headers may have been changed before the failure, so close the executable and let the next
+				// command read it again from the file.
+				CloseExecutable(vArgs[1]);
+				response = "ERROR: Failed to add section\n";
+			}
+		}
+	}
+	else if (name == "extend" && vArgs.size() == 4)
+	{
+		DWORD additionalSize = 0;
+
+		// Parse the number of bytes to add to the section.
+		XboxExecutable *pXbe = nullptr;
+		if (ParseSectionSize(vArgs[3].c_str(), &additionalSize) == false)
+			response = "ERROR: Invalid section size\n";
+		else if ((pXbe = OpenExecutable(vArgs[1], response)) != nullptr)
+		{
+			// Extend the section.
+			if (pXbe->ExtendSection(vArgs[2], additionalSize) == true)
+				response = "OK\n" + FormatLayout(pXbe);
+			else
+			{
+				// The section header may have been changed before the failure, so close the executable and let the next
+				// command read it again from the file.
+				CloseExecutable(vArgs[1]);
+				response = "ERROR: Failed to extend section\n";
+			}
+		}
+	}
+	else if (name == "write" && vArgs.size() == 4)
+	{
+		// Write the payload file to the section.
+		InjectPayload(vArgs[1], vArgs[2], vArgs[3], response);
+	}
+	else if (name == "patch" && vArgs.size() == 4)
+	{
+		// Parse the patch bytes, rejecting anything that isn't a hex digit.
+		std::vector<BYTE> vPatchData;
+		const std::string &hexData = vArgs[3];
+		bool validHex = hexData.size() > 0 && hexData.size() % 2 == 0;
+		for (size_t i = 0; i < hexData.size() && validHex == true; i++)
+			validHex = isxdigit((BYTE)hexData[i]) != 0;
+
+		for (size_t i = 0; i + 1 < hexData.size() && validHex == true; i += 2)
+			vPatchData.push_back((BYTE)strtoul(hexData.substr(i, 2).c_str(), nullptr, 16));
+
+		// Parse the patch address.
+		char *pAddressEnd = nullptr;
+		DWORD patchAddress = strtoul(vArgs[2].c_str(), &pAddressEnd, 16);
+
+		// Write the patch to the executable.
+		XboxExecutable *pXbe = nullptr;
+		if (vArgs[2].empty() == true || *pAddressEnd != 0)
+			response = "ERROR: Invalid patch address\n";
+		else if (validHex == false)
+			response = "ERROR: Invalid patch data\n";
+		else if ((pXbe = OpenExecutable(vArgs[1], response)) != nullptr)
+		{
+			if (pXbe->WriteVirtualData(patchAddress, vPatchData.data(), (DWORD)vPatchData.size()) == true)
+				response = "OK\n";
+			else
+				response = "ERROR: Failed to write patch\n";
+		}
+	}
+	else if (name == "layout" && vArgs.size() == 2)
+	{
+		// Print the section layout of the executable.
+		XboxExecutable *pXbe = OpenExecutable(vArgs[1], response);
+		if (pXbe != nullptr)
+			response = "OK\n" + FormatLayout(pXbe);
+	}
+	else if (name == "watch" && vArgs.size() == 4)
+	{
+		XBOX_DAEMON_WATCH sWatch;
+		WIN32_FILE_ATTRIBUTE_DATA sFileInfo;
+
+		// Inject the payload now so the image is up to date before we start watching it.
+		if (GetFileAttributesExA(vArgs[3].c_str(), GetFileExInfoStandard, &sFileInfo) == FALSE)
+			response = "ERROR: Payload file not found\n";
+		else if (InjectPayload(vArgs[1], vArgs[2], vArgs[3], response) == true)
+		{
+			// Add the payload to the watch list.
+			sWatch.sFileName = vArgs[1];
+			sWatch.sSectionName = vArgs[2];
+			sWatch.sPayloadFileName = vArgs[3];
+			sWatch.ftLastWriteTime = sFileInfo.ftLastWriteTime;
+			this->vWatches.push_back(sWatch);
+		}
+	}
+	else if (name == "unwatch" && vArgs.size() == 2)
+	{
+		// Remove all watches for the payload file.
+		size_t watchCount = this->vWatches.size();
+		for (size_t i = 0; i < this->vWatches.size(); )
+		{
+			if (this->vWatches[i].sPayloadFileName == vArgs[1])
+				this->vWatches.erase(this->vWatches.begin() + i);
+			else
+				i++;
+		}
+
+		response = watchCount != this->vWatches.size() ? "OK\n" : "ERROR: Payload file is not being watched\n";
+	}
+	else if (name == "quit" && vArgs.size() == 1)
+	{
+		// Stop the daemon.
+		this->bRunning = false;
+		response = "OK\n";
+	}
+	else
+	{
+		// Unknown command.
+		response = "ERROR: Unknown command or invalid arguments \"" + name + "\"\n";
+	}
+
+	// Stop capturing and add the output to the response.
+	CaptureOutput(nullptr);
+	response += output;
+
+	LeaveCriticalSection(&this->sLock);
+	return response;
+}
+
+XboxExecutable *XboxImageDaemon::OpenExecutable(std::string fileName, std::string &response)
+{
+	// Check if the executable is already open.
+	auto iter = this->mExecutables.find(fileName);
+	if (iter != this->mExecutables.end())
+		return iter->second;
+
+	// Create a new XboxExecutable object and try to read it.
+	XboxExecutable *pXbe = new XboxExecutable(fileName);
+	if (pXbe->ReadExecutable(false) == false)
+	{
+		// Failed to read xbe.
+		response = "ERROR: Failed to read executable\n";
+		delete pXbe;
+		return nullptr;
+	}
+
+	// Keep the executable resident for future commands.
+	this->mExecutables.emplace(fileName, pXbe);
+	return pXbe;
+}
+
+bool XboxImageDaemon::CloseExecutable(std::string fileName)
+{
+	// Check if the executable is open.
+	auto iter = this->mExecutables.find(fileName);
+	if (iter == this->mExecutables.end())
+		return false;
+
+	// Close the executable.
+	delete iter->second;
+	this->mExecutables.erase(iter);
+	return true;
+}
+
+bool XboxImageDaemon::InjectPayload(std::string fileName, std::string sectionName, std::string payloadFileName, std::string &response)
+{
+	std::vector<BYTE> vPayload;
+
+	// Read the payload file.
+	if (ReadPayloadFile(payloadFileName, vPayload) == false)
+	{
+		response = "ERROR: Failed to read payload file\n";
+		return false;
+	}
+
+	// Write the payload to the section.
+	return WritePayload(fileName, sectionName, payloadFileName, vPayload, response);
+}
+
+bool XboxImageDaemon::WritePayload(std::string fileName, std::string sectionName, std::string payloadFileName, const std::vector<BYTE> &vPayload,
+	std::string &response)
+{
+	char szBuffer[256];
+
+	// Get the executable to write to.
+	XboxExecutable *pXbe = OpenExecutable(fileName, response);
+	if (pXbe == nullptr)
+		return false;
+
+	// Write the payload to the section.
+	if (pXbe->WriteSectionData(sectionName, vPayload.data(), (DWORD)vPayload.size()) == false)
+	{
+		response = "ERROR: Failed to write payload\n";
+		return false;
+	}
+
+	snprintf(szBuffer, sizeof(szBuffer), "0x%08x", (DWORD)vPayload.size());
+	response = "OK\nWrote " + std::string(szBuffer) + " bytes from \"" + payloadFileName + "\" to section " + sectionName + " of \"" + fileName + "\"\n";
+	return true;
+}
+
+std::string XboxImageDaemon::FormatLayout(XboxExecutable *pXbe)
+{
+	std::string layout;
+	char szBuffer[256];
+
+	// Loop through all the sections and print their layout.
+	layout = "Name            Virtual Address  Virtual Size  File Offset  File Size  Flags\n";
+	for (int i = 0; i < pXbe->GetSectionCount(); i++)
+	{
+		const XBE_IMAGE_SECTION_HEADER *pSection = pXbe->GetSectionHeader(i);
+		snprintf(szBuffer, sizeof(szBuffer), "%-15.15s 0x%08x       0x%08x    0x%08x   0x%08x 0x%08x\n", pXbe->GetSectionName(i).c_str(), pSection->VirtualAddress,
+			pSection->VirtualSize, pSection->RawAddress, pSection->RawSize, pSection->SectionFlags);
+		layout += szBuffer;
+	}
+
+	return layout;
+}
+
+bool XboxImageDaemon::ReadPayloadFile(std::string fileName, std::vector<BYTE> &vData)
+{
+	DWORD BytesRead = 0;
+
+	// Open the payload file, allowing whatever produced it to keep it open.
+	HANDLE hFile = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Read the whole file.
+	DWORD fileSize = GetFileSize(hFile, nullptr);
+	vData.resize(fileSize);
+	if (fileSize == INVALID_FILE_SIZE || (fileSize > 0 && (ReadFile(hFile, vData.data(), fileSize, &BytesRead, nullptr) == FALSE || BytesRead != fileSize)))
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+
+	CloseHandle(hFile);
+	return true;
+}
+
+std::vector<std::string> XboxImageDaemon::SplitCommand(std::string command)
+{
+	std::vector<std::string> vArgs;
+	size_t i = 0;
+
+	// Loop and split the command on whitespace, arguments can be quoted to include spaces.
+	while (i < command.size())
+	{
+		// Skip whitespace.
+		if (isspace((BYTE)command[i]))
+		{
+			i++;
+			continue;
+		}
+
+		// Find the end of the argument.
+		size_t start = i;
+		if (command[i] == '"')
+		{
+			start = ++i;
+			while (i < command.size() && command[i] != '"')
+				i++;
+
+			vArgs.push_back(command.substr(start, i - start));
+			i++;
+		}
+		else
+		{
+			while (i < command.size() && !isspace((BYTE)command[i]))
+				i++;
+
+			vArgs.push_back(command.substr(start, i - start));
+		}
+	}
+
+	return vArgs;
+}
@@ -0,0 +1,75 @@
+/*
+	XboxImageXploder - Utility for modifying xbox executables.
+
+	XboxImageDaemon.h - Types and functions for keeping xbox executables resident and modifying them on request.
+
+	Author - Grimdoomer
+*/
+
+#pragma once
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "XboxExecutable.h"
+
+// ---------------------------------------------------------------------------------------
+// Types
+// ---------------------------------------------------------------------------------------
+
+#define XBOX_DAEMON_DEFAULT_PIPE_NAME		"XboxImageXploder"
+#define XBOX_DAEMON_PIPE_PREFIX				"\\\\.\\pipe\\"
+
+#define XBOX_DAEMON_MAX_COMMAND_SIZE		0x1000
+#define XBOX_DAEMON_MAX_RESPONSE_SIZE		0x10000
+
+// How often watched payload files are checked for changes, in milliseconds.
+#define XBOX_DAEMON_WATCH_INTERVAL			50
+
+// How long the client waits for the daemon pipe to become available, in milliseconds.
+#define XBOX_DAEMON_CLIENT_TIMEOUT			5000
+
+struct XBOX_DAEMON_WATCH
+{
+	std::string		sFileName;				// Xbe file the payload is written to
+	std::string		sSectionName;			// Section the payload is written to
+	std::string		sPayloadFileName;		// Payload file being watched
+	FILETIME		ftLastWriteTime;		// Last write time of the payload when it was injected
+};
+
+// ---------------------------------------------------------------------------------------
+// XboxImageDaemon
+// ---------------------------------------------------------------------------------------
+class XboxImageDaemon
+{
+private:
+	std::string							sPipeName;
+	volatile bool						bRunning;
+
+	std::map<std::string, XboxExecutable*>	mExecutables;
+	std::vector<XBOX_DAEMON_WATCH>		vWatches;
+
+	CRITICAL_SECTION					sLock;
+
+	static DWORD WINAPI WatchThreadProc(LPVOID lpParameter);
+	void PollWatches();
+
+	std::string ExecuteCommand(std::string command);
+	XboxExecutable *OpenExecutable(std::string fileName, std::string &response);
+	bool CloseExecutable(std::string fileName);
+	bool InjectPayload(std::string fileName, std::string sectionName, std::string payloadFileName, std::string &response);
+	bool WritePayload(std::string fileName, std::string sectionName, std::string payloadFileName, const std::vector<BYTE> &vPayload,
+		std::string &response);
+	std::string FormatLayout(XboxExecutable *pXbe);
+
+	static bool ReadPayloadFile(std::string fileName, std::vector<BYTE> &vData);
+	static std::vector<std::string> SplitCommand(std::string command);
+
+public:
+	XboxImageDaemon(std::string pipeName);
+	~XboxImageDaemon();
+
+	bool Run();
+
+	static bool SendCommand(std::string pipeName, std::string command);
+};
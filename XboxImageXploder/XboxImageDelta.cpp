@@ -0,0 +1,413 @@
+/*
+	XboxImageXploder - Utility for modifying xbox executables.
+
+	XboxImageDelta.cpp - Types and functions for creating and applying binary deltas between xbox executable files.
+
+	Author - Grimdoomer
+*/
+
+#include "XboxImageDelta.h"
+#include "XboxExecutable.h"
+
+XboxImageDelta::XboxImageDelta() : vRecords(), vPayload()
+{
+	// Initialize fields.
+	this->pbSourceData = nullptr;
+	this->sourceFileSize = 0;
+	memset(&this->sHeader, 0, sizeof(XBE_DELTA_HEADER));
+}
+
+XboxImageDelta::~XboxImageDelta()
+{
+	// Free the source file snapshot if allocated.
+	if (this->pbSourceData)
+	{
+		free(this->pbSourceData);
+	}
+}
+
+bool XboxImageDelta::ReadEntireFile(HANDLE hFile, BYTE **ppbData, DWORD *pFileSize)
+{
+	DWORD BytesRead = 0;
+
+	// Allocate a buffer for the file contents.
+	DWORD fileSize = GetFileSize(hFile, nullptr);
+	BYTE *pbData = (BYTE*)malloc(max(fileSize, (DWORD)1));
+	if (pbData == nullptr)
+	{
+		// Failed to allocate memory for the file data.
+		printf("Failed to allocate memory for file data!\n");
+		return false;
+	}
+
+	// Seek to the start of the file and read the whole thing.
+	SetFilePointer(hFile, 0, nullptr, FILE_BEGIN);
+	if (ReadFile(hFile, pbData, fileSize, &BytesRead, nullptr) == FALSE || BytesRead != fileSize)
+	{
+		// Failed to read the file data.
+		printf("Failed to read file data!\n");
+		free(pbData);
+		return false;
+	}
+
+	*ppbData = pbData;
+	*pFileSize = fileSize;
+	return true;
+}
+
+bool XboxImageDelta::CaptureSource(HANDLE hFile)
+{
+	// Free any previous snapshot.
+	if (this->pbSourceData)
+	{
+		free(this->pbSourceData);
+		this->pbSourceData = nullptr;
+	}
+
+	// Snapshot the original file contents so we can diff against them once the image has been modified.
+	if (ReadEntireFile(hFile, &this->pbSourceData, &this->sourceFileSize) == false)
+		return false;
+
+	// Hash the original file.
+	if (CalculateSHA1Digest(this->pbSourceData, this->sourceFileSize, this->sHeader.SourceDigest) == false)
+	{
+		// Failed to hash the source file.
+		printf("Failed to calculate source file digest!\n");
+		return false;
+	}
+
+	this->sHeader.SourceFileSize = this->sourceFileSize;
+	return true;
+}
+
+bool XboxImageDelta::CaptureTarget(HANDLE hFile)
+{
+	BYTE *pbTargetData = nullptr;
+	DWORD targetFileSize = 0;
+
+	// Make sure the source was captured first.
+	if (this->pbSourceData == nullptr)
+		return false;
+
+	// Read the modified file contents.
+	if (ReadEntireFile(hFile, &pbTargetData, &targetFileSize) == false)
+		return false;
+
+	// Hash the modified file.
+	if (CalculateSHA1Digest(pbTargetData, targetFileSize, this->sHeader.TargetDigest) == false)
+	{
+		// Failed to hash the target file.
+		printf("Failed to calculate target file digest!\n");
+		free(pbTargetData);
+		return false;
+	}
+
+	// Clear any previous records.
+	this->vRecords.clear();
+	this->vPayload.clear();
+
+	// Loop through the range both files share and find all the runs of changed bytes.
+	DWORD overlapSize = min(this->sourceFileSize, targetFileSize);
+	DWORD offset = 0;
+	while (offset < overlapSize)
+	{
+		// Skip bytes that have not changed.
+		if (this->pbSourceData[offset] == pbTargetData[offset])
+		{
+			offset++;
+			continue;
+		}
+
+		// Find the end of the changed run, merging in any short runs of unchanged bytes.
+		DWORD runStart = offset;
+		DWORD runEnd = offset + 1;
+		for (DWORD i = runEnd; i < overlapSize && i - runEnd < XBE_DELTA_MERGE_GAP; i++)
+		{
+			if (this->pbSourceData[i] != pbTargetData[i])
+				runEnd = i + 1;
+		}
+
+		// Add records for the changed run.
+		AddRecords(runStart, pbTargetData + runStart, runEnd - runStart);
+		offset = runEnd;
+	}
+
+	// Add records for any data appended to the end of the file.
+	if (targetFileSize > overlapSize)
+		AddRecords(overlapSize, pbTargetData + overlapSize, targetFileSize - overlapSize);
+
+	// Fill out the rest of the delta header.
+	this->sHeader.Magic = XBE_DELTA_MAGIC;
+	this->sHeader.Version = XBE_DELTA_VERSION;
+	this->sHeader.TargetFileSize = targetFileSize;
+	this->sHeader.NumberOfRecords = (DWORD)this->vRecords.size();
+	this->sHeader.PayloadSize = (DWORD)this->vPayload.size();
+
+	free(pbTargetData);
+	return true;
+}
+
+void XboxImageDelta::AddRecords(DWORD fileOffset, const BYTE *pbData, DWORD length)
+{
+	// Split the run into data and zero records so long runs of zeros don't take up space in the payload.
+	DWORD dataStart = 0;
+	DWORD offset = 0;
+	while (offset < length)
+	{
+		// Check if this is the start of a run of zeros.
+		if (pbData[offset] != 0)
+		{
+			offset++;
+			continue;
+		}
+
+		// Find the end of the zero run.
+		DWORD zeroStart = offset;
+		while (offset < length && pbData[offset] == 0)
+			offset++;
+
+		// Zero runs that are too short are cheaper to keep in the data record.
+		if (offset - zeroStart < XBE_DELTA_MIN_ZERO_RUN)
+			continue;
+
+		// Flush any pending data before the zero run and add a record for the zeros.
+		if (zeroStart > dataStart)
+			AddRecord(XBE_DELTA_RECORD_TYPE_DATA, fileOffset + dataStart, pbData + dataStart, zeroStart - dataStart);
+
+		AddRecord(XBE_DELTA_RECORD_TYPE_ZERO, fileOffset + zeroStart, nullptr, offset - zeroStart);
+		dataStart = offset;
+	}
+
+	// Flush any remaining data.
+	if (length > dataStart)
+		AddRecord(XBE_DELTA_RECORD_TYPE_DATA, fileOffset + dataStart, pbData + dataStart, length - dataStart);
+}
+
+void XboxImageDelta::AddRecord(DWORD type, DWORD fileOffset, const BYTE *pbData, DWORD length)
+{
+	// Setup the record.
+	XBE_DELTA_RECORD sRecord;
+	sRecord.Type = type;
+	sRecord.FileOffset = fileOffset;
+	sRecord.Length = length;
+	this->vRecords.push_back(sRecord);
+
+	// Data records carry their bytes in the payload.
+	if (type == XBE_DELTA_RECORD_TYPE_DATA)
+		this->vPayload.insert(this->vPayload.end(), pbData, pbData + length);
+}
+
+bool XboxImageDelta::WriteDeltaFile(std::string fileName)
+{
+	DWORD BytesWritten = 0;
+
+	// Make sure the delta has been created.
+	if (this->sHeader.Magic != XBE_DELTA_MAGIC)
+		return false;
+
+	// Create the delta file.
+	HANDLE hDeltaFile = CreateFileA(fileName.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hDeltaFile == INVALID_HANDLE_VALUE)
+	{
+		// Failed to create the delta file.
+		printf("Failed to create \"%s\": %d\n", fileName.c_str(), GetLastError());
+		return false;
+	}
+
+	// Write the header, record table, and payload.
+	DWORD recordsSize = (DWORD)(this->vRecords.size() * sizeof(XBE_DELTA_RECORD));
+	if (WriteFile(hDeltaFile, &this->sHeader, sizeof(XBE_DELTA_HEADER), &BytesWritten, nullptr) == FALSE || BytesWritten != sizeof(XBE_DELTA_HEADER) ||
+		(recordsSize > 0 && (WriteFile(hDeltaFile, this->vRecords.data(), recordsSize, &BytesWritten, nullptr) == FALSE || BytesWritten != recordsSize)) ||
+		(this->sHeader.PayloadSize > 0 && (WriteFile(hDeltaFile, this->vPayload.data(), this->sHeader.PayloadSize, &BytesWritten, nullptr) == FALSE || BytesWritten != this->sHeader.PayloadSize)))
+	{
+		// Failed to write the delta file.
+		printf("Failed to write delta file!\n");
+		CloseHandle(hDeltaFile);
+		return false;
+	}
+
+	CloseHandle(hDeltaFile);
+
+	// Print the delta info.
+	DWORD deltaSize = sizeof(XBE_DELTA_HEADER) + recordsSize + this->sHeader.PayloadSize;
+	printf("Delta File: \t\t%s\n", fileName.c_str());
+	printf("Delta Records: \t\t%d\n", this->sHeader.NumberOfRecords);
+	printf("Delta Size: \t\t0x%08x (target file 0x%08x)\n\n", deltaSize, this->sHeader.TargetFileSize);
+	return true;
+}
+
+bool XboxImageDelta::ApplyDeltaFile(std::string deltaFileName, std::string fileName)
+{
+	bool result = false;
+	DWORD BytesWritten = 0;
+	BYTE *pbDeltaData = nullptr;
+	BYTE *pbFileData = nullptr;
+	DWORD deltaFileSize = 0;
+	DWORD fileSize = 0;
+	BYTE abDigest[XBE_DELTA_DIGEST_LENGTH];
+	BYTE abZeroData[0x1000] = { 0 };
+	XBE_DELTA_HEADER *pHeader = nullptr;
+	XBE_DELTA_RECORD *pRecords = nullptr;
+	BYTE *pbPayload = nullptr;
+	BYTE *pbPatchedData = nullptr;
+	DWORD payloadOffset = 0;
+
+	// Open the delta file for reading.
+	HANDLE hDeltaFile = CreateFileA(deltaFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hDeltaFile == INVALID_HANDLE_VALUE)
+	{
+		// Failed to open the delta file.
+		printf("Failed to open \"%s\": %d\n", deltaFileName.c_str(), GetLastError());
+		return false;
+	}
+
+	// Read the delta file.
+	bool deltaRead = ReadEntireFile(hDeltaFile, &pbDeltaData, &deltaFileSize);
+	CloseHandle(hDeltaFile);
+	if (deltaRead == false)
+		return false;
+
+	// Open the image file for reading and writing.
+	HANDLE hFile = CreateFileA(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		// Failed to open the file.
+		printf("Failed to open \"%s\": %d\n", fileName.c_str(), GetLastError());
+		free(pbDeltaData);
+		return false;
+	}
+
+	// Validate the delta header.
+	pHeader = (XBE_DELTA_HEADER*)pbDeltaData;
+	if (deltaFileSize < sizeof(XBE_DELTA_HEADER) || pHeader->Magic != XBE_DELTA_MAGIC || pHeader->Version != XBE_DELTA_VERSION ||
+		(ULONGLONG)sizeof(XBE_DELTA_HEADER) + (ULONGLONG)pHeader->NumberOfRecords * sizeof(XBE_DELTA_RECORD) + pHeader->PayloadSize != deltaFileSize)
+	{
+		// Delta file is invalid.
+		printf("Delta file is invalid!\n");
+		goto Cleanup;
+	}
+
+	pRecords = (XBE_DELTA_RECORD*)(pbDeltaData + sizeof(XBE_DELTA_HEADER));
+	pbPayload = (BYTE*)(pRecords + pHeader->NumberOfRecords);
+
+	// Read the image file and make sure it's the file the delta was created from.
+	if (ReadEntireFile(hFile, &pbFileData, &fileSize) == false)
+		goto Cleanup;
+
+	if (fileSize != pHeader->SourceFileSize || CalculateSHA1Digest(pbFileData, fileSize, abDigest) == false ||
+		memcmp(abDigest, pHeader->SourceDigest, XBE_DELTA_DIGEST_LENGTH) != 0)
+	{
+		// File does not match the delta source.
+		printf("\"%s\" does not match the source file of the delta!\n", fileName.c_str());
+		goto Cleanup;
+	}
+
+	// Allocate a buffer to build the patched image in, so we can verify the result before touching the file.
+	pbPatchedData = (BYTE*)malloc(max(pHeader->TargetFileSize, (DWORD)1));
+	if (pbPatchedData == nullptr)
+	{
+		// Failed to allocate memory for the patched image.
+		printf("Failed to allocate memory for patched image!\n");
+		goto Cleanup;
+	}
+
+	// Anything past the end of the source file is zero unless a record says otherwise.
+	memset(pbPatchedData, 0, pHeader->TargetFileSize);
+	memcpy(pbPatchedData, pbFileData, min(fileSize, pHeader->TargetFileSize));
+
+	// Loop and apply all the records to the patched image buffer.
+	for (DWORD i = 0; i < pHeader->NumberOfRecords; i++)
+	{
+		// Make sure the record is within the bounds of the target file and payload.
+		if ((ULONGLONG)pRecords[i].FileOffset + pRecords[i].Length > pHeader->TargetFileSize ||
+			(pRecords[i].Type == XBE_DELTA_RECORD_TYPE_DATA && (ULONGLONG)payloadOffset + pRecords[i].Length > pHeader->PayloadSize) ||
+			pRecords[i].Type > XBE_DELTA_RECORD_TYPE_ZERO)
+		{
+			// Delta record is invalid.
+			printf("Delta record %d is invalid!\n", i);
+			goto Cleanup;
+		}
+
+		if (pRecords[i].Type == XBE_DELTA_RECORD_TYPE_DATA)
+		{
+			memcpy(pbPatchedData + pRecords[i].FileOffset, pbPayload + payloadOffset, pRecords[i].Length);
+			payloadOffset += pRecords[i].Length;
+		}
+		else
+			memset(pbPatchedData + pRecords[i].FileOffset, 0, pRecords[i].Length);
+	}
+
+	// Make sure the patched image is what the delta expects.
+	if (CalculateSHA1Digest(pbPatchedData, pHeader->TargetFileSize, abDigest) == false ||
+		memcmp(abDigest, pHeader->TargetDigest, XBE_DELTA_DIGEST_LENGTH) != 0)
+	{
+		// Patched image does not match the target.
+		printf("Patched image does not match the target file of the delta!\n");
+		goto Cleanup;
+	}
+
+	// Loop and write each record to the file.
+	payloadOffset = 0;
+	for (DWORD i = 0; i < pHeader->NumberOfRecords; i++)
+	{
+		// Data records are written straight from the payload.
+		if (pRecords[i].Type == XBE_DELTA_RECORD_TYPE_DATA)
+		{
+			SetFilePointer(hFile, pRecords[i].FileOffset, nullptr, FILE_BEGIN);
+			if (WriteFile(hFile, pbPayload + payloadOffset, pRecords[i].Length, &BytesWritten, nullptr) == FALSE || BytesWritten != pRecords[i].Length)
+			{
+				// Failed to write the record data.
+				printf("Failed to write delta record %d!\n", i);
+				goto Cleanup;
+			}
+
+			payloadOffset += pRecords[i].Length;
+			continue;
+		}
+
+		// Zero runs past the end of the source file are filled in for us when the file is extended, so only
+		// zero runs inside the original file need to be written.
+		if (pRecords[i].FileOffset >= fileSize)
+			continue;
+
+		SetFilePointer(hFile, pRecords[i].FileOffset, nullptr, FILE_BEGIN);
+		DWORD zeroSize = min(pRecords[i].Length, fileSize - pRecords[i].FileOffset);
+		while (zeroSize > 0)
+		{
+			DWORD chunkSize = min(zeroSize, (DWORD)sizeof(abZeroData));
+			if (WriteFile(hFile, abZeroData, chunkSize, &BytesWritten, nullptr) == FALSE || BytesWritten != chunkSize)
+			{
+				// Failed to write the record data.
+				printf("Failed to write delta record %d!\n", i);
+				goto Cleanup;
+			}
+
+			zeroSize -= chunkSize;
+		}
+	}
+
+	// Set the final size of the file.
+	SetFilePointer(hFile, pHeader->TargetFileSize, nullptr, FILE_BEGIN);
+	if (SetEndOfFile(hFile) == FALSE)
+	{
+		// Failed to set the file size.
+		printf("Failed to set file size: %d\n", GetLastError());
+		goto Cleanup;
+	}
+
+	// Successfully applied the delta.
+	printf("Applied %d delta records to \"%s\"\n", pHeader->NumberOfRecords, fileName.c_str());
+	result = true;
+
+Cleanup:
+	// Free temporary buffers and close the file.
+	if (pbPatchedData)
+		free(pbPatchedData);
+	if (pbFileData)
+		free(pbFileData);
+
+	free(pbDeltaData);
+	CloseHandle(hFile);
+
+	return result;
+}
@@ -0,0 +1,80 @@
+/*
+	XboxImageXploder - Utility for modifying xbox executables.
+
+	XboxImageDelta.h - Types and functions for creating and applying binary deltas between xbox executable files.
+
+	Author - Grimdoomer
+*/
+
+#pragma once
+#include <Windows.h>
+#include <string>
+#include <vector>
+
+// ---------------------------------------------------------------------------------------
+// Types
+// ---------------------------------------------------------------------------------------
+
+#define XBE_DELTA_MAGIC					'TLDX'
+#define XBE_DELTA_VERSION				1
+
+#define XBE_DELTA_DIGEST_LENGTH			20
+
+// Changed runs separated by fewer than this many unchanged bytes are merged into a single record, since a new
+// record costs more than just carrying the unchanged bytes along.
+#define XBE_DELTA_MERGE_GAP				sizeof(XBE_DELTA_RECORD)
+
+// Runs of zero bytes shorter than this are stored as data rather than as a separate zero record.
+#define XBE_DELTA_MIN_ZERO_RUN			(sizeof(XBE_DELTA_RECORD) * 2)
+
+struct XBE_DELTA_HEADER
+{
+	/* 0x00 */ DWORD		Magic;
+	/* 0x04 */ DWORD		Version;
+	/* 0x08 */ DWORD		SourceFileSize;
+	/* 0x0C */ DWORD		TargetFileSize;
+	/* 0x10 */ BYTE			SourceDigest[XBE_DELTA_DIGEST_LENGTH];
+	/* 0x24 */ BYTE			TargetDigest[XBE_DELTA_DIGEST_LENGTH];
+	/* 0x38 */ DWORD		NumberOfRecords;
+	/* 0x3C */ DWORD		PayloadSize;
+};
+
+#define XBE_DELTA_RECORD_TYPE_DATA		0			// Length bytes are copied from the payload to FileOffset
+#define XBE_DELTA_RECORD_TYPE_ZERO		1			// Length bytes at FileOffset are set to 0
+
+struct XBE_DELTA_RECORD
+{
+	/* 0x00 */ DWORD		Type;
+	/* 0x04 */ DWORD		FileOffset;
+	/* 0x08 */ DWORD		Length;
+};
+
+// ---------------------------------------------------------------------------------------
+// XboxImageDelta
+// ---------------------------------------------------------------------------------------
+class XboxImageDelta
+{
+private:
+	BYTE						*pbSourceData;
+	DWORD						sourceFileSize;
+
+	XBE_DELTA_HEADER			sHeader;
+	std::vector<XBE_DELTA_RECORD>	vRecords;
+	std::vector<BYTE>			vPayload;
+
+	void AddRecords(DWORD fileOffset, const BYTE *pbData, DWORD length);
+	void AddRecord(DWORD type, DWORD fileOffset, const BYTE *pbData, DWORD length);
+
+	static bool ReadEntireFile(HANDLE hFile, BYTE **ppbData, DWORD *pFileSize);
+
+public:
+	XboxImageDelta();
+	~XboxImageDelta();
+
+	bool CaptureSource(HANDLE hFile);
+	bool CaptureTarget(HANDLE hFile);
+
+	bool WriteDeltaFile(std::string fileName);
+
+	static bool ApplyDeltaFile(std::string deltaFileName, std::string fileName);
+};
@@ -4,46 +4,288 @@
 #include <Windows.h>
 #include <string>
 #include "XboxExecutable.h"
+#include "XboxBatchProcessor.h"
+#include "XboxImageDelta.h"
+#include "XboxImageDaemon.h"
+
+// Optional arguments that can follow the required arguments.
+struct XPLODER_OPTIONS
+{
+	std::string		sDeltaFileName;			// File to write a delta of the changes made to the image to
+	DWORD			sectionFlags;			// Flags for the new section
+	DWORD			ramBudget;				// Memory budget to warn about exceeding, 0 for no budget
+	bool			packedLayout;			// Pack the new section data instead of page aligning it in the file
+
+	XPLODER_OPTIONS() : sDeltaFileName()
+	{
+		this->sectionFlags = XBE_SECTION_FLAGS_HACKS_DEFAULT;
+		this->ramBudget = XBOX_RETAIL_RAM_SIZE;
+		this->packedLayout = false;
+	}
+};
 
 void PrintUse()
 {
-	printf("XboxImageXploder.exe <xbe_file> <section_name> <section_size>\n\n");
+	printf("XboxImageXploder.exe <xbe_file> <section_name> <section_size> [options]\n");
+	printf("XboxImageXploder.exe -batch <list_file> <section_name> <section_size> [max_in_flight] [options]\n");
+	printf("XboxImageXploder.exe -apply <delta_file> <xbe_file>\n");
+	printf("XboxImageXploder.exe -verify <xbe_file>\n");
+	printf("XboxImageXploder.exe -verify -batch <list_file> [max_in_flight]\n");
+	printf("XboxImageXploder.exe -daemon [pipe_name]\n");
+	printf("XboxImageXploder.exe -send <pipe_name> <command> [arguments]\n\n");
+	printf("Options:\n");
+	printf("  -delta <delta_file>\tWrite a delta of the changes that can be applied to the original xbe\n");
+	printf("  -flags <wpx>\t\tFlags for the new section: w = writable, p = preload, x = executable (default: wpx)\n");
+	printf("  -budget <bytes>\tWarn if the memory committed at boot exceeds this many bytes (default: 64MB, 0 to disable)\n");
+	printf("  -packed\t\tPack the new section data in the file instead of page aligning it\n\n");
 }
 
-int main(int argc, char **argv)
+bool ParseOptions(int argc, char **argv, int start, XPLODER_OPTIONS *pOptions)
 {
-	printf("XboxImageXploder v1.2 by Grimdoomer\n\n");
-
-	// Check if the correct number of arguments were provided.
-	if (argc != 4)
+	// Loop and parse all the optional arguments.
+	for (int i = start; i < argc; i++)
 	{
-		// Invalid number of arguments.
-		PrintUse();
-		return 0;
+		if (_stricmp(argv[i], "-delta") == 0 && i + 1 < argc)
+		{
+			pOptions->sDeltaFileName = argv[++i];
+		}
+		else if (_stricmp(argv[i], "-flags") == 0 && i + 1 < argc)
+		{
+			if (ParseSectionFlags(argv[++i], &pOptions->sectionFlags) == false)
+				return false;
+		}
+		else if (_stricmp(argv[i], "-budget") == 0 && i + 1 < argc)
+		{
+			// Parse the budget and make sure the whole string was used.
+			char *pEnd = nullptr;
+			const char *psBudget = argv[++i];
+			pOptions->ramBudget = strtoul(psBudget, &pEnd, 0);
+			if (*psBudget == 0 || *psBudget == '-' || *pEnd != 0)
+			{
+				// Invalid memory budget.
+				printf("Invalid memory budget \"%s\", must be a number of bytes\n\n", psBudget);
+				return false;
+			}
+		}
+		else if (_stricmp(argv[i], "-packed") == 0)
+		{
+			pOptions->packedLayout = true;
+		}
+		else
+		{
+			// Unknown option.
+			printf("Unknown option \"%s\"\n\n", argv[i]);
+			return false;
+		}
 	}
 
-	// Parse the arguments.
-	std::string sFileName(argv[1]);
-	std::string sSectionName(argv[2]);
-	int sectionSize = atoi(argv[3]);
+	return true;
+}
+
+bool ExplodeExecutable(const std::string &fileName, const std::string &sectionName, DWORD sectionSize, const XPLODER_OPTIONS &options)
+{
+	XboxImageDelta delta;
 
 	// Create a new XboxExecutable object and try to read it.
-	XboxExecutable *pXbe = new XboxExecutable(sFileName);
-	if (pXbe->ReadExecutable() == false)
+	XboxExecutable *pXbe = new XboxExecutable(fileName);
+	if (pXbe->ReadExecutable(false) == false)
 	{
 		// Failed to read xbe.
 		delete pXbe;
-		return 0;
+		return false;
+	}
+
+	// If we are creating a delta snapshot the image before it's modified.
+	if (options.sDeltaFileName.empty() == false && delta.CaptureSource(pXbe->GetFileHandle()) == false)
+	{
+		// Failed to snapshot the original image.
+		delete pXbe;
+		return false;
 	}
 
 	// Try to add the new section to the executable.
-	if (pXbe->AddSectionForHacks(sSectionName, sectionSize) == false)
+	if (pXbe->AddSectionForHacks(sectionName, sectionSize, options.sectionFlags, options.packedLayout) == false)
 	{
 		// Failed to add new section to the file.
 		delete pXbe;
+		return false;
+	}
+
+	// Print how much memory the image will use now that the section has been added.
+	pXbe->PrintMemoryReport(options.ramBudget);
+
+	// Diff the modified image against the original and write out the delta.
+	if (options.sDeltaFileName.empty() == false)
+	{
+		if (delta.CaptureTarget(pXbe->GetFileHandle()) == false || delta.WriteDeltaFile(options.sDeltaFileName) == false)
+		{
+			// Failed to create the delta file.
+			XboxPrintf("Failed to create delta file!\n");
+			delete pXbe;
+			return false;
+		}
+	}
+
+	// Close the executable so the file handle is released.
+	delete pXbe;
+	return true;
+}
+
+bool VerifyExecutable(const std::string &fileName)
+{
+	std::string report;
+
+	// Create a new XboxExecutable object and try to read it without opening it for writing.
+	XboxExecutable *pXbe = new XboxExecutable(fileName);
+	if (pXbe->ReadExecutable(true) == false)
+	{
+		// Failed to read xbe, the reason has already been printed.
+		XboxPrintf("  ERROR: Failed to parse image headers\n");
+		delete pXbe;
+		return false;
+	}
+
+	// Check the image for structural problems and print them.
+	bool result = pXbe->VerifyExecutable(report);
+	XboxPrintf("%s", report.c_str());
+
+	delete pXbe;
+	return result;
+}
+
+int main(int argc, char **argv)
+{
+	printf("XboxImageXploder v1.2 by Grimdoomer\n\n");
+
+	XPLODER_OPTIONS options;
+
+	// Check if we are applying a delta.
+	if (argc == 4 && _stricmp(argv[1], "-apply") == 0)
+	{
+		// Apply the delta to the executable.
+		if (XboxImageDelta::ApplyDeltaFile(argv[2], argv[3]) == false)
+			return 0;
+
+		// Successfully applied the delta.
+		printf("Successfully applied delta to image!\n");
+		return 0;
+	}
+
+	// Check if we are verifying executables.
+	if (argc >= 3 && _stricmp(argv[1], "-verify") == 0)
+	{
+		// Check if we are verifying a list of files.
+		if (argc >= 4 && argc <= 5 && _stricmp(argv[2], "-batch") == 0)
+		{
+			// Load the list of files to verify.
+			XboxBatchProcessor batch(argc == 5 ? atoi(argv[4]) : 0);
+			if (batch.LoadFileList(argv[3]) == false)
+				return 0;
+
+			// Verify every file in the list.
+			batch.Run([](const std::string &fileName) { return VerifyExecutable(fileName); });
+
+			// Print the batch results.
+			printf("\nVerified %d files: %d valid, %d invalid\n", batch.GetFileCount(), batch.GetSucceededCount(), batch.GetFailedCount());
+			return 0;
+		}
+		else if (argc == 3)
+		{
+			// Verify the executable.
+			if (VerifyExecutable(argv[2]) == true)
+				printf("Image is valid!\n");
+			else
+				printf("Image is invalid!\n");
+
+			return 0;
+		}
+
+		// Invalid arguments.
+		PrintUse();
+		return 0;
+	}
+
+	// Check if we are running as a daemon.
+	if ((argc == 2 || argc == 3) && _stricmp(argv[1], "-daemon") == 0)
+	{
+		// Run the daemon until it's told to quit.
+		XboxImageDaemon daemon(argc == 3 ? argv[2] : XBOX_DAEMON_DEFAULT_PIPE_NAME);
+		daemon.Run();
+		return 0;
+	}
+
+	// Check if we are sending a command to a daemon.
+	if (argc >= 4 && _stricmp(argv[1], "-send") == 0)
+	{
+		// Build the command string, quoting any arguments that contain spaces.
+		std::string command;
+		for (int i = 3; i < argc; i++)
+		{
+			if (i > 3)
+				command += " ";
+
+			if (strchr(argv[i], ' ') != nullptr)
+				command += "\"" + std::string(argv[i]) + "\"";
+			else
+				command += argv[i];
+		}
+
+		// Send the command to the daemon.
+		XboxImageDaemon::SendCommand(argv[2], command);
 		return 0;
 	}
 
+	// Check if we are running in batch mode.
+	if (argc >= 5 && _stricmp(argv[1], "-batch") == 0)
+	{
+		// Parse the arguments.
+		std::string sListFileName(argv[2]);
+		std::string sSectionName(argv[3]);
+		DWORD sectionSize = 0;
+		int maxInFlight = 0;
+		int optionsStart = 5;
+		if (argc >= 6 && argv[5][0] != '-')
+			maxInFlight = atoi(argv[optionsStart++]);
+
+		// Parse the section size and optional arguments, a single delta file can't describe changes made to multiple images.
+		if (ParseSectionSize(argv[4], &sectionSize) == false || ParseOptions(argc, argv, optionsStart, &options) == false ||
+			options.sDeltaFileName.empty() == false)
+		{
+			// Invalid arguments.
+			PrintUse();
+			return 0;
+		}
+
+		// Load the list of files to process.
+		XboxBatchProcessor batch(maxInFlight);
+		if (batch.LoadFileList(sListFileName) == false)
+			return 0;
+
+		// Add the new section to every file in the list.
+		batch.Run([&](const std::string &fileName) { return ExplodeExecutable(fileName, sSectionName, sectionSize, options); });
+
+		// Print the batch results.
+		printf("\nProcessed %d files: %d succeeded, %d failed\n", batch.GetFileCount(), batch.GetSucceededCount(), batch.GetFailedCount());
+		return 0;
+	}
+
+	// Check if the correct number of arguments were provided.
+	DWORD sectionSize = 0;
+	if (argc < 4 || ParseSectionSize(argv[3], &sectionSize) == false || ParseOptions(argc, argv, 4, &options) == false)
+	{
+		// Invalid number of arguments.
+		PrintUse();
+		return 0;
+	}
+
+	// Parse the arguments.
+	std::string sFileName(argv[1]);
+	std::string sSectionName(argv[2]);
+
+	// Try to add the new section to the executable.
+	if (ExplodeExecutable(sFileName, sSectionName, sectionSize, options) == false)
+		return 0;
+
 	// Successfully added the new section.
 	printf("Successfully added new section to image!\n");
     return 0;